@@ -0,0 +1,143 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#pragma once
+
+/*
+ * The few engine types and helpers the texture core uses, on top of the
+ * standard library, so that it builds without the engine. Only what the
+ * core needs is here, with the engine's semantics: this is not a general
+ * replacement, and must never be on the include path of the mod itself.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+
+typedef std::uint8_t uint8;
+typedef std::uint16_t uint16;
+typedef std::uint32_t uint32;
+typedef std::uint64_t uint64;
+typedef std::int8_t int8;
+typedef std::int16_t int16;
+typedef std::int32_t int32;
+typedef std::int64_t int64;
+
+#define FORCEINLINE inline __attribute__((always_inline))
+#define RESTRICT __restrict
+#define TEXT(x) x
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PLATFORM_CPU_X86_FAMILY 1
+#else
+#define PLATFORM_CPU_X86_FAMILY 0
+#endif
+#ifndef PLATFORM_ENABLE_VECTORINTRINSICS
+#define PLATFORM_ENABLE_VECTORINTRINSICS 1
+#endif
+#define PLATFORM_ALWAYS_HAS_AVX_2 0
+
+#define UE_SMALL_NUMBER (1.e-8f)
+#define UE_KINDA_SMALL_NUMBER (1.e-4f)
+#define UE_DOUBLE_SMALL_NUMBER (1.e-8)
+
+/* Checks stay on in every configuration, like in the mod */
+#define fgcheck(Expr) \
+	do { \
+		if (not (Expr)) { \
+			std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #Expr); \
+			std::abort(); \
+		} \
+	} while (0)
+#define fgcheckf(Expr, Format, ...) \
+	do { \
+		if (not (Expr)) { \
+			std::fprintf(stderr, "%s:%d: check failed: %s: " Format "\n", __FILE__, __LINE__, #Expr, ##__VA_ARGS__); \
+			std::abort(); \
+		} \
+	} while (0)
+
+template<typename T>
+constexpr T Align(const T Value, const T Alignment)
+{
+	return (Value + Alignment - 1) / Alignment * Alignment;
+}
+
+template<typename T>
+FORCEINLINE void Swap(T& A, T& B)
+{
+	std::swap(A, B);
+}
+
+template<typename T>
+struct TNumericLimits
+{
+	static constexpr T Min() { return std::numeric_limits<T>::min(); }
+	static constexpr T Max() { return std::numeric_limits<T>::max(); }
+	static constexpr T Lowest() { return std::numeric_limits<T>::lowest(); }
+};
+
+struct FMath
+{
+	template<typename T> static constexpr T Min(const T A, const T B) { return A < B ? A : B; }
+	template<typename T> static constexpr T Max(const T A, const T B) { return A > B ? A : B; }
+	template<typename T> static constexpr T Max3(const T A, const T B, const T C) { return Max(Max(A, B), C); }
+	template<typename T> static constexpr T Clamp(const T X, const T Lo, const T Hi) { return X < Lo ? Lo : X > Hi ? Hi : X; }
+	template<typename T> static constexpr T Square(const T A) { return A * A; }
+	template<typename T> static constexpr T Abs(const T A) { return A < 0 ? -A : A; }
+	template<typename T, typename U> static constexpr T Lerp(const T& A, const T& B, const U& Alpha) { return static_cast<T>(A + Alpha * (B - A)); }
+	template<typename T> static constexpr T DivideAndRoundUp(const T Dividend, const T Divisor) { return (Dividend + Divisor - 1) / Divisor; }
+	static float Pow(const float A, const float B) { return std::pow(A, B); }
+	static double Pow(const double A, const double B) { return std::pow(A, B); }
+	static float InvSqrt(const float F) { return 1.0f / std::sqrt(F); }
+	static int32 FloorToInt(const float F) { return static_cast<int32>(std::floor(F)); }
+	static int32 FloorToInt(const double F) { return static_cast<int32>(std::floor(F)); }
+	static int32 RoundToInt(const float F) { return FloorToInt(F + 0.5f); }
+	static int32 RoundToInt(const double F) { return FloorToInt(F + 0.5); }
+	static uint64 CountTrailingZeros64(const uint64 Value) { return Value == 0 ? 64 : __builtin_ctzll(Value); }
+};
+
+struct FMemory
+{
+	static void* Memcpy(void* Dest, const void* Src, const size_t Count) { return std::memcpy(Dest, Src, Count); }
+	static void* Memzero(void* Dest, const size_t Count) { return std::memset(Dest, 0, Count); }
+	template<typename T> static void Memzero(T& Value) { std::memset(&Value, 0, sizeof(T)); }
+	static int32 Memcmp(const void* A, const void* B, const size_t Count) { return std::memcmp(A, B, Count); }
+};
+
+/* Contiguous and value-initialized, Num() is an int32 as in the engine */
+template<typename T>
+class TArray
+{
+public:
+	int32 Num() const { return static_cast<int32>(Items.size()); }
+	bool IsEmpty() const { return Items.empty(); }
+	T* GetData() { return Items.data(); }
+	const T* GetData() const { return Items.data(); }
+	T& operator[](const int32 Index) { return Items[Index]; }
+	const T& operator[](const int32 Index) const { return Items[Index]; }
+	void SetNumUninitialized(const int32 NewNum) { Items.resize(NewNum); }
+	void SetNumZeroed(const int32 NewNum) { Items.assign(NewNum, T()); }
+	void SetNum(const int32 NewNum) { Items.resize(NewNum); }
+	void Reserve(const int32 Number) { Items.reserve(Number); }
+	int32 Add(const T& Item) { Items.push_back(Item); return Num() - 1; }
+	void Reset() { Items.clear(); }
+	void Empty() { Items.clear(); Items.shrink_to_fit(); }
+	T* begin() { return Items.data(); }
+	T* end() { return Items.data() + Items.size(); }
+	const T* begin() const { return Items.data(); }
+	const T* end() const { return Items.data() + Items.size(); }
+private:
+	std::vector<T> Items;
+};
+
+struct FLinearColor
+{
+	float R, G, B, A;
+};
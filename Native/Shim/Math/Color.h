@@ -0,0 +1,39 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#pragma once
+
+#include <CoreMinimal.h>
+
+/* The engine's DXT block layouts, bit for bit */
+
+struct FDXTColor565
+{
+	uint16 B : 5;
+	uint16 G : 6;
+	uint16 R : 5;
+};
+
+struct FDXTColor16
+{
+	union
+	{
+		FDXTColor565 Color565;
+		uint16 Value;
+	};
+};
+
+struct FDXT1
+{
+	union
+	{
+		FDXTColor16 Color[2];
+		uint32 Colors;
+	};
+	uint32 Indices;
+};
+
+struct FDXT5
+{
+	uint8 Alpha[8];
+	FDXT1 DXT1;
+};
@@ -0,0 +1,172 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#include "DXTDecoder.h"
+#include "DXTEncoder.h"
+#include "BCDecoder.h"
+#include "BlendKernels.h"
+#include "PlanarBlock.h"
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * Th3CoreBench [Size ...] [Iterations=N]
+ *
+ * The hot loops of the icon pipeline without the engine, on random
+ * blocks: decoding single blocks and whole mips into planar float
+ * buffers, the "over" kernel and encoding back into blocks. Single
+ * threaded, the numbers are per core. Meant to be run under perf or a sanitizer, Th3.Benchmark in
+ * game covers the parts that need textures.
+ */
+
+using FClock = std::chrono::steady_clock;
+
+/* Best of Iterations, in seconds */
+template<typename FuncT>
+static double TimeBest(const int32 Iterations, FuncT&& Func)
+{
+	double Best = TNumericLimits<double>::Max();
+	for (int32 i = 0; i < Iterations; i++) {
+		const FClock::time_point Begin = FClock::now();
+		Func();
+		Best = FMath::Min(Best, std::chrono::duration<double>(FClock::now() - Begin).count());
+	}
+	return Best;
+}
+
+static void Report(const char* Stage, const char* Format, const int32 Size, const double Seconds)
+{
+	const double NumPixels = static_cast<double>(Size) * Size;
+	const double NumBlocks = NumPixels / MAX_BLOCK_PIXELS;
+	std::printf("%-8s %-12s %5d  %9.2f Mpixels/s  %8.1f ns/block\n", Stage, Format, Size, NumPixels / Seconds / 1e6, Seconds * 1e9 / NumBlocks);
+}
+
+template<typename BlockT>
+static std::vector<BlockT> MakeRandomBlocks(const int32 Size, const uint32 Seed)
+{
+	std::mt19937_64 Random(Seed);
+	std::vector<BlockT> Blocks(static_cast<size_t>(Size / MAX_BLOCK_SIDE) * (Size / MAX_BLOCK_SIDE));
+	std::vector<uint64> Bits((sizeof(BlockT) * Blocks.size() + 7) / 8);
+	for (uint64& Word : Bits) {
+		Word = Random();
+	}
+	FMemory::Memcpy(Blocks.data(), Bits.data(), sizeof(BlockT) * Blocks.size());
+	return Blocks;
+}
+
+template<typename BlockT, typename DecodeT>
+static void DecodeMip(FPlanarMip& OutMip, const std::vector<BlockT>& Blocks, const int32 Size, DecodeT Decode)
+{
+	OutMip.Init(Size, Size);
+	const int32 NumBlocksX = Size / MAX_BLOCK_SIDE;
+	FPlanarBlock Block;
+	for (size_t i = 0; i < Blocks.size(); i++) {
+		Decode(Block, Blocks[i]);
+		StorePlanarBlock(OutMip, Block, (i % NumBlocksX) * MAX_BLOCK_SIDE, (i / NumBlocksX) * MAX_BLOCK_SIDE);
+	}
+}
+
+/* Into one block that stays in L1, the decoder without the stores into the mip */
+template<typename BlockT, typename DecodeT>
+static void DecodeBlocks(FPlanarBlock& OutBlock, const std::vector<BlockT>& Blocks, DecodeT Decode)
+{
+	for (const BlockT& Block : Blocks) {
+		Decode(OutBlock, Block);
+	}
+}
+
+template<typename BlockT, typename EncodeT>
+static void EncodeMip(std::vector<BlockT>& OutBlocks, const FPlanarMip& InMip, EncodeT Encode)
+{
+	const int32 NumBlocksX = InMip.SizeX / MAX_BLOCK_SIDE;
+	OutBlocks.resize(static_cast<size_t>(NumBlocksX) * (InMip.SizeY / MAX_BLOCK_SIDE));
+	FPlanarBlock Block;
+	for (size_t i = 0; i < OutBlocks.size(); i++) {
+		LoadPlanarBlock(Block, InMip, (i % NumBlocksX) * MAX_BLOCK_SIDE, (i / NumBlocksX) * MAX_BLOCK_SIDE);
+		Encode(OutBlocks[i], Block);
+	}
+}
+
+static void RunSize(const int32 Size, const int32 Iterations)
+{
+	const std::vector<FDXT1> DXT1 = MakeRandomBlocks<FDXT1>(Size, 1);
+	const std::vector<FDXT5> DXT5 = MakeRandomBlocks<FDXT5>(Size, 2);
+	const std::vector<FBC7> BC7 = MakeRandomBlocks<FBC7>(Size, 3);
+	FPlanarMip Bot, Top, Out;
+	FPlanarBlock Block;
+
+	Report("Block", "DXT1", Size, TimeBest(Iterations, [&]() {
+		DecodeBlocks(Block, DXT1, &DXTDecoder::DecodeDXT1);
+	}));
+	Report("Block", "DXT1 scalar", Size, TimeBest(Iterations, [&]() {
+		DecodeBlocks(Block, DXT1, &DXTDecoder::DecodeDXT1Scalar);
+	}));
+	Report("Block", "DXT5", Size, TimeBest(Iterations, [&]() {
+		DecodeBlocks(Block, DXT5, &DXTDecoder::DecodeDXT5);
+	}));
+	Report("Block", "DXT5 scalar", Size, TimeBest(Iterations, [&]() {
+		DecodeBlocks(Block, DXT5, &DXTDecoder::DecodeDXT5Scalar);
+	}));
+
+	Report("Decode", "DXT1", Size, TimeBest(Iterations, [&]() {
+		DecodeMip(Bot, DXT1, Size, &DXTDecoder::DecodeDXT1);
+	}));
+	Report("Decode", "DXT1 scalar", Size, TimeBest(Iterations, [&]() {
+		DecodeMip(Bot, DXT1, Size, &DXTDecoder::DecodeDXT1Scalar);
+	}));
+	Report("Decode", "DXT5 scalar", Size, TimeBest(Iterations, [&]() {
+		DecodeMip(Top, DXT5, Size, &DXTDecoder::DecodeDXT5Scalar);
+	}));
+	Report("Decode", "BC7", Size, TimeBest(Iterations, [&]() {
+		DecodeMip(Top, BC7, Size, &BCDecoder::DecodeBC7);
+	}));
+	/* Last, so that Top is DXT5 for the stages below */
+	Report("Decode", "DXT5", Size, TimeBest(Iterations, [&]() {
+		DecodeMip(Top, DXT5, Size, &DXTDecoder::DecodeDXT5);
+	}));
+
+	Report("Over", "Float", Size, TimeBest(Iterations, [&]() {
+		BlendKernels::OverStraight(Out, Bot, Top);
+	}));
+
+	for (const bool bRefine : { false, true }) {
+		const DXTEncoder::FEncodeOptions Options = { .bRefine = bRefine };
+		std::vector<FDXT1> OutDXT1;
+		std::vector<FDXT5> OutDXT5;
+		Report("Encode", bRefine ? "DXT1 refine" : "DXT1", Size, TimeBest(Iterations, [&]() {
+			EncodeMip(OutDXT1, Out, [&Options](FDXT1& Block, const FPlanarBlock& In) { DXTEncoder::EncodeDXT1(Block, In, Options); });
+		}));
+		Report("Encode", bRefine ? "DXT5 refine" : "DXT5", Size, TimeBest(Iterations, [&]() {
+			EncodeMip(OutDXT5, Out, [&Options](FDXT5& Block, const FPlanarBlock& In) { DXTEncoder::EncodeDXT5(Block, In, Options); });
+		}));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<int32> Sizes;
+	int32 Iterations = 5;
+	for (int i = 1; i < argc; i++) {
+		const std::string Arg = argv[i];
+		if (Arg.rfind("Iterations=", 0) == 0) {
+			Iterations = FMath::Max(std::atoi(Arg.c_str() + 11), 1);
+			continue;
+		}
+		const int32 Size = std::atoi(Arg.c_str());
+		if (Size >= 4 and (Size & (Size - 1)) == 0) {
+			Sizes.push_back(Size);
+		} else {
+			std::fprintf(stderr, "Ignoring '%s', sizes are powers of two from 4\n", Arg.c_str());
+		}
+	}
+	if (Sizes.empty()) {
+		Sizes = { 64, 256, 1024, 4096 };
+	}
+	std::printf("SIMD: SSE2 %d, AVX2 %d\n", TH3_SIMD_SSE2, TH3_SIMD_AVX2);
+	for (const int32 Size : Sizes) {
+		RunSize(Size, Iterations);
+	}
+	return 0;
+}
@@ -0,0 +1,355 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#include "BCDecoder.h"
+
+static void DecodeBC4Plane(float* OutPlane, const FBC4& InBlock)
+{
+	DXTDecoder::FAlphaPalette Palette;
+	DXTDecoder::BuildAlphaPalette(Palette, InBlock.Red[0], InBlock.Red[1]);
+	uint64 Bits = 0;
+	for (int32 i = 0; i < 6; i++) {
+		Bits |= static_cast<uint64>(InBlock.Red[2 + i]) << (8 * i);
+	}
+	for (int32 i = 0; i < 16; i++) {
+		OutPlane[i] = Palette.A[(Bits >> (3 * i)) & 0x07];
+	}
+}
+
+static void FillPlane(float* OutPlane, const float Value)
+{
+	for (int32 i = 0; i < 16; i++) {
+		OutPlane[i] = Value;
+	}
+}
+
+void BCDecoder::DecodeBC4(FPlanarBlock& OutBlock, const FBC4& InBlock)
+{
+	DecodeBC4Plane(OutBlock.R, InBlock);
+	FillPlane(OutBlock.G, 0.0f);
+	FillPlane(OutBlock.B, 0.0f);
+	FillPlane(OutBlock.A, 1.0f);
+}
+
+void BCDecoder::DecodeBC5(FPlanarBlock& OutBlock, const FBC5& InBlock)
+{
+	DecodeBC4Plane(OutBlock.R, InBlock.Red);
+	DecodeBC4Plane(OutBlock.G, InBlock.Green);
+	FillPlane(OutBlock.B, 0.0f);
+	FillPlane(OutBlock.A, 1.0f);
+}
+
+struct FBC7Mode
+{
+	uint8 NumSubsets;
+	uint8 PartitionBits;
+	uint8 RotationBits;
+	uint8 IndexSelectionBits;
+	uint8 ColorBits;
+	uint8 AlphaBits;
+	/* One P-bit per endpoint, or one per subset shared by both endpoints */
+	uint8 EndpointPBits;
+	uint8 SharedPBits;
+	uint8 IndexBits;
+	uint8 Index2Bits;
+};
+
+static constexpr FBC7Mode BC7_MODES[8] = {
+	{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+	{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+	{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+	{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+	{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+	{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+	{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+	{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+};
+
+/* Bit i is set when pixel i belongs to the second subset */
+static constexpr uint16 BC7_PARTITIONS_2[64] = {
+	0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+	0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+	0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+	0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+	0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+	0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+	0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+	0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+};
+
+static constexpr uint8 BC7_PARTITIONS_3[64][16] = {
+	{ 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2 },
+	{ 0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1 },
+	{ 0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+	{ 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2 },
+	{ 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2 },
+	{ 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1 },
+	{ 0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2 },
+	{ 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2 },
+	{ 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+	{ 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2 },
+	{ 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2 },
+	{ 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2 },
+	{ 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2 },
+	{ 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0 },
+	{ 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2 },
+	{ 0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0 },
+	{ 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2 },
+	{ 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1 },
+	{ 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2 },
+	{ 0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1 },
+	{ 0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2 },
+	{ 0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0 },
+	{ 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0 },
+	{ 0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2 },
+	{ 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0 },
+	{ 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1 },
+	{ 0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2 },
+	{ 0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2 },
+	{ 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1 },
+	{ 0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1 },
+	{ 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2 },
+	{ 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1 },
+	{ 0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2 },
+	{ 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0 },
+	{ 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0 },
+	{ 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+	{ 0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0 },
+	{ 0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1 },
+	{ 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1 },
+	{ 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1 },
+	{ 0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2 },
+	{ 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1 },
+	{ 0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1 },
+	{ 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1 },
+	{ 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1 },
+	{ 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2 },
+	{ 0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1 },
+	{ 0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2 },
+	{ 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2 },
+	{ 0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2 },
+	{ 0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2 },
+	{ 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2 },
+	{ 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2 },
+	{ 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2 },
+	{ 0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2 },
+	{ 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1 },
+	{ 0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2 },
+	{ 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 },
+	{ 0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0 },
+};
+
+/* The first index of each subset is stored with one bit less, subset 0 always starts at pixel 0 */
+static constexpr uint8 BC7_ANCHORS_2[64] = {
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+	15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+	 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+};
+
+static constexpr uint8 BC7_ANCHORS_3[2][64] = {
+	{
+		 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+		 3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+		 8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+		 3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3,
+	},
+	{
+		15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+		15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+		15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+		15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8,
+	},
+};
+
+static constexpr uint8 BC7_WEIGHTS_2[4] = { 0, 21, 43, 64 };
+static constexpr uint8 BC7_WEIGHTS_3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static constexpr uint8 BC7_WEIGHTS_4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static const uint8* GetWeights(const int32 NumBits)
+{
+	switch (NumBits) {
+	case 2:
+		return BC7_WEIGHTS_2;
+	case 3:
+		return BC7_WEIGHTS_3;
+	default:
+		return BC7_WEIGHTS_4;
+	}
+}
+
+/* Fields are stored from the lowest bit of the block up */
+struct FBitReader
+{
+	uint64 Lo;
+	uint64 Hi;
+	int32 Pos = 0;
+
+	FORCEINLINE uint32 Read(const int32 NumBits)
+	{
+		if (NumBits == 0) {
+			return 0;
+		}
+		uint64 Bits;
+		if (Pos >= 64) {
+			Bits = Hi >> (Pos - 64);
+		} else if (Pos == 0) {
+			Bits = Lo;
+		} else {
+			Bits = (Lo >> Pos) | (Hi << (64 - Pos));
+		}
+		Pos += NumBits;
+		return static_cast<uint32>(Bits & ((1ull << NumBits) - 1));
+	}
+};
+
+/* Quantized endpoint (with its P-bit, if any) back to 8 bits, by replicating the high bits */
+static FORCEINLINE uint8 Unquantize(uint32 Value, const int32 NumBits)
+{
+	Value <<= 8 - NumBits;
+	return static_cast<uint8>(Value | (Value >> NumBits));
+}
+
+static FORCEINLINE uint8 Interpolate(const uint8 E0, const uint8 E1, const uint8 Weight)
+{
+	return static_cast<uint8>(((64 - Weight) * E0 + Weight * E1 + 32) >> 6);
+}
+
+#if TH3_SIMD_SSE2
+static FORCEINLINE void StoreUnorm8Plane(float* OutPlane, const uint8* InPlane)
+{
+	const __m128i Bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(InPlane));
+	const __m128i Zero = _mm_setzero_si128();
+	const __m128i Lo = _mm_unpacklo_epi8(Bytes, Zero);
+	const __m128i Hi = _mm_unpackhi_epi8(Bytes, Zero);
+	const __m128 Scale = _mm_set1_ps(1.0f / 255.0f);
+	_mm_store_ps(OutPlane + 0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(Lo, Zero)), Scale));
+	_mm_store_ps(OutPlane + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(Lo, Zero)), Scale));
+	_mm_store_ps(OutPlane + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(Hi, Zero)), Scale));
+	_mm_store_ps(OutPlane + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(Hi, Zero)), Scale));
+}
+#else
+static FORCEINLINE void StoreUnorm8Plane(float* OutPlane, const uint8* InPlane)
+{
+	for (int32 i = 0; i < 16; i++) {
+		OutPlane[i] = InPlane[i] * (1.0f / 255.0f);
+	}
+}
+#endif
+
+void BCDecoder::DecodeBC7(FPlanarBlock& OutBlock, const FBC7& InBlock)
+{
+	/* Mode m is stored as m zero bits followed by a one */
+	const int32 ModeIdx = FMath::CountTrailingZeros64(InBlock.Lo | (1ull << 8));
+	if (ModeIdx >= 8) {
+		FMemory::Memzero(OutBlock);
+		return;
+	}
+	const FBC7Mode& Mode = BC7_MODES[ModeIdx];
+	FBitReader Reader = { .Lo = InBlock.Lo, .Hi = InBlock.Hi, .Pos = ModeIdx + 1 };
+
+	const uint32 Partition = Reader.Read(Mode.PartitionBits);
+	const uint32 Rotation = Reader.Read(Mode.RotationBits);
+	const uint32 IndexSelection = Reader.Read(Mode.IndexSelectionBits);
+
+	/* Subset, endpoint, channel */
+	uint32 Endpoints[3][2][4] = {};
+	for (int32 c = 0; c < 3; c++) {
+		for (int32 s = 0; s < Mode.NumSubsets; s++) {
+			Endpoints[s][0][c] = Reader.Read(Mode.ColorBits);
+			Endpoints[s][1][c] = Reader.Read(Mode.ColorBits);
+		}
+	}
+	for (int32 s = 0; s < Mode.NumSubsets; s++) {
+		Endpoints[s][0][3] = Reader.Read(Mode.AlphaBits);
+		Endpoints[s][1][3] = Reader.Read(Mode.AlphaBits);
+	}
+	uint32 PBits[3][2] = {};
+	for (int32 s = 0; s < Mode.NumSubsets; s++) {
+		if (Mode.EndpointPBits) {
+			PBits[s][0] = Reader.Read(1);
+			PBits[s][1] = Reader.Read(1);
+		}
+	}
+	for (int32 s = 0; s < Mode.NumSubsets; s++) {
+		if (Mode.SharedPBits) {
+			PBits[s][0] = PBits[s][1] = Reader.Read(1);
+		}
+	}
+	const int32 NumPBits = Mode.EndpointPBits | Mode.SharedPBits;
+
+	uint8 Colors[3][2][4];
+	for (int32 s = 0; s < Mode.NumSubsets; s++) {
+		for (int32 e = 0; e < 2; e++) {
+			for (int32 c = 0; c < 3; c++) {
+				Colors[s][e][c] = Unquantize((Endpoints[s][e][c] << NumPBits) | PBits[s][e], Mode.ColorBits + NumPBits);
+			}
+			Colors[s][e][3] = Mode.AlphaBits ? Unquantize((Endpoints[s][e][3] << NumPBits) | PBits[s][e], Mode.AlphaBits + NumPBits) : 0xff;
+		}
+	}
+
+	uint8 Subsets[16] = {};
+	bool bIsAnchor[16] = { true };
+	if (Mode.NumSubsets == 2) {
+		for (int32 i = 0; i < 16; i++) {
+			Subsets[i] = (BC7_PARTITIONS_2[Partition] >> i) & 1;
+		}
+		bIsAnchor[BC7_ANCHORS_2[Partition]] = true;
+	} else if (Mode.NumSubsets == 3) {
+		FMemory::Memcpy(Subsets, BC7_PARTITIONS_3[Partition], sizeof(Subsets));
+		bIsAnchor[BC7_ANCHORS_3[0][Partition]] = true;
+		bIsAnchor[BC7_ANCHORS_3[1][Partition]] = true;
+	}
+
+	uint8 Indices[16];
+	for (int32 i = 0; i < 16; i++) {
+		Indices[i] = static_cast<uint8>(Reader.Read(Mode.IndexBits - (bIsAnchor[i] ? 1 : 0)));
+	}
+	uint8 Indices2[16] = {};
+	if (Mode.Index2Bits) {
+		for (int32 i = 0; i < 16; i++) {
+			Indices2[i] = static_cast<uint8>(Reader.Read(Mode.Index2Bits - (i == 0 ? 1 : 0)));
+		}
+	}
+
+	/* With two index sets, the selection bit says which one the colors use */
+	const uint8* ColorIndices = Indices;
+	const uint8* AlphaIndices = Indices;
+	int32 ColorIndexBits = Mode.IndexBits;
+	int32 AlphaIndexBits = Mode.IndexBits;
+	if (Mode.Index2Bits) {
+		AlphaIndices = Indices2;
+		AlphaIndexBits = Mode.Index2Bits;
+		if (IndexSelection) {
+			Swap(ColorIndices, AlphaIndices);
+			Swap(ColorIndexBits, AlphaIndexBits);
+		}
+	}
+	const uint8* ColorWeights = GetWeights(ColorIndexBits);
+	const uint8* AlphaWeights = GetWeights(AlphaIndexBits);
+
+	uint8 Planes[4][16];
+	for (int32 i = 0; i < 16; i++) {
+		const uint8 (&Subset)[2][4] = Colors[Subsets[i]];
+		for (int32 c = 0; c < 3; c++) {
+			Planes[c][i] = Interpolate(Subset[0][c], Subset[1][c], ColorWeights[ColorIndices[i]]);
+		}
+		Planes[3][i] = Interpolate(Subset[0][3], Subset[1][3], AlphaWeights[AlphaIndices[i]]);
+	}
+
+	/* Alpha was stored in place of one of the colors */
+	if (Rotation > 0) {
+		for (int32 i = 0; i < 16; i++) {
+			Swap(Planes[3][i], Planes[Rotation - 1][i]);
+		}
+	}
+
+	StoreUnorm8Plane(OutBlock.R, Planes[0]);
+	StoreUnorm8Plane(OutBlock.G, Planes[1]);
+	StoreUnorm8Plane(OutBlock.B, Planes[2]);
+	StoreUnorm8Plane(OutBlock.A, Planes[3]);
+}
@@ -0,0 +1,88 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#include "BlendKernels.h"
+
+#if TH3_SIMD_AVX2
+using VecF = __m256;
+static constexpr int32 NUM_LANES = 8;
+static FORCEINLINE VecF VLoad(const float* Ptr) { return _mm256_loadu_ps(Ptr); }
+static FORCEINLINE void VStore(float* Ptr, const VecF V) { _mm256_storeu_ps(Ptr, V); }
+static FORCEINLINE VecF VSet(const float Value) { return _mm256_set1_ps(Value); }
+static FORCEINLINE VecF VAdd(const VecF A, const VecF B) { return _mm256_add_ps(A, B); }
+static FORCEINLINE VecF VSub(const VecF A, const VecF B) { return _mm256_sub_ps(A, B); }
+static FORCEINLINE VecF VMul(const VecF A, const VecF B) { return _mm256_mul_ps(A, B); }
+static FORCEINLINE VecF VDiv(const VecF A, const VecF B) { return _mm256_div_ps(A, B); }
+/* Lanes where Value > Threshold keep Value, all others become zero */
+static FORCEINLINE VecF VKeepGreater(const VecF Value, const VecF Threshold, const VecF Test) { return _mm256_and_ps(_mm256_cmp_ps(Test, Threshold, _CMP_GT_OQ), Value); }
+#elif TH3_SIMD_SSE2
+using VecF = __m128;
+static constexpr int32 NUM_LANES = 4;
+static FORCEINLINE VecF VLoad(const float* Ptr) { return _mm_loadu_ps(Ptr); }
+static FORCEINLINE void VStore(float* Ptr, const VecF V) { _mm_storeu_ps(Ptr, V); }
+static FORCEINLINE VecF VSet(const float Value) { return _mm_set1_ps(Value); }
+static FORCEINLINE VecF VAdd(const VecF A, const VecF B) { return _mm_add_ps(A, B); }
+static FORCEINLINE VecF VSub(const VecF A, const VecF B) { return _mm_sub_ps(A, B); }
+static FORCEINLINE VecF VMul(const VecF A, const VecF B) { return _mm_mul_ps(A, B); }
+static FORCEINLINE VecF VDiv(const VecF A, const VecF B) { return _mm_div_ps(A, B); }
+static FORCEINLINE VecF VKeepGreater(const VecF Value, const VecF Threshold, const VecF Test) { return _mm_and_ps(_mm_cmpgt_ps(Test, Threshold), Value); }
+#endif
+
+using FOverPlanes = BlendKernels::TOverPlanes<FFloatPrecision>;
+
+void BlendKernels::OverStraightScalar(FPlanarMip& Out, const FPlanarMip& Bot, const FPlanarMip& Top)
+{
+	const FOverPlanes P(Out, Bot, Top);
+	BlendKernels::OverStraightPixels(P, 0, P.Num);
+}
+
+void BlendKernels::OverPremultipliedScalar(FPlanarMip& Out, const FPlanarMip& Bot, const FPlanarMip& Top)
+{
+	const FOverPlanes P(Out, Bot, Top);
+	BlendKernels::OverPremultipliedPixels(P, 0, P.Num);
+}
+
+#if TH3_SIMD_SSE2
+void BlendKernels::OverStraight(FPlanarMip& Out, const FPlanarMip& Bot, const FPlanarMip& Top)
+{
+	const FOverPlanes P(Out, Bot, Top);
+	const VecF One = VSet(1.0f);
+	const VecF Small = VSet(UE_SMALL_NUMBER);
+	int32 i = 0;
+	for (; i + NUM_LANES <= P.Num; i += NUM_LANES) {
+		const VecF TopCoef = VLoad(&P.Top[3][i]);
+		const VecF BotCoef = VMul(VLoad(&P.Bot[3][i]), VSub(One, TopCoef));
+		const VecF Alpha = VAdd(TopCoef, BotCoef);
+		const VecF InvAlpha = VKeepGreater(VDiv(One, Alpha), Small, Alpha);
+		for (int32 c = 0; c < 3; c++) {
+			const VecF Sum = VAdd(VMul(VLoad(&P.Top[c][i]), TopCoef), VMul(VLoad(&P.Bot[c][i]), BotCoef));
+			VStore(&P.Out[c][i], VMul(Sum, InvAlpha));
+		}
+		VStore(&P.Out[3][i], VKeepGreater(Alpha, Small, Alpha));
+	}
+	BlendKernels::OverStraightPixels(P, i, P.Num);
+}
+
+void BlendKernels::OverPremultiplied(FPlanarMip& Out, const FPlanarMip& Bot, const FPlanarMip& Top)
+{
+	const FOverPlanes P(Out, Bot, Top);
+	const VecF One = VSet(1.0f);
+	int32 i = 0;
+	for (; i + NUM_LANES <= P.Num; i += NUM_LANES) {
+		const VecF BotCoef = VSub(One, VLoad(&P.Top[3][i]));
+		for (int32 c = 0; c < 4; c++) {
+			VStore(&P.Out[c][i], VAdd(VLoad(&P.Top[c][i]), VMul(VLoad(&P.Bot[c][i]), BotCoef)));
+		}
+	}
+	BlendKernels::OverPremultipliedPixels(P, i, P.Num);
+}
+#else
+void BlendKernels::OverStraight(FPlanarMip& Out, const FPlanarMip& Bot, const FPlanarMip& Top)
+{
+	OverStraightScalar(Out, Bot, Top);
+}
+
+void BlendKernels::OverPremultiplied(FPlanarMip& Out, const FPlanarMip& Bot, const FPlanarMip& Top)
+{
+	OverPremultipliedScalar(Out, Bot, Top);
+}
+#endif
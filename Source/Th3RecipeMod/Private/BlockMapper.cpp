@@ -1,24 +1,86 @@
 /* SPDX-License-Identifier: MPL-2.0 */
 
 #include "BlockMapper.h"
+#include "DXTDecoder.h"
+#include "BCDecoder.h"
+#include "DXTEncoder.h"
 #include "Th3Utilities.h"
+#include "TextureResidency.h"
+
+#include <Async/ParallelFor.h>
+
+/* Below this, a mip is not worth the scheduling overhead */
+static const int32 MIN_PARALLEL_ROWS = 8;
+
+static FORCEINLINE void DecodePlanarBlock(FPlanarBlock& OutBlock, const FDXT1& InBlock)
+{
+	DXTDecoder::DecodeDXT1(OutBlock, InBlock);
+}
+
+static FORCEINLINE void DecodePlanarBlock(FPlanarBlock& OutBlock, const FDXT5& InBlock)
+{
+	DXTDecoder::DecodeDXT5(OutBlock, InBlock);
+}
+
+static FORCEINLINE void DecodePlanarBlock(FPlanarBlock& OutBlock, const FBC4& InBlock)
+{
+	BCDecoder::DecodeBC4(OutBlock, InBlock);
+}
+
+static FORCEINLINE void DecodePlanarBlock(FPlanarBlock& OutBlock, const FBC5& InBlock)
+{
+	BCDecoder::DecodeBC5(OutBlock, InBlock);
+}
+
+static FORCEINLINE void DecodePlanarBlock(FPlanarBlock& OutBlock, const FBC7& InBlock)
+{
+	BCDecoder::DecodeBC7(OutBlock, InBlock);
+}
+
+template<typename NativeBlockType>
+static constexpr bool IS_DECODE_ONLY_BLOCK = std::is_same_v<NativeBlockType, FBC4> or std::is_same_v<NativeBlockType, FBC5> or std::is_same_v<NativeBlockType, FBC7>;
+
+static FORCEINLINE void LoadPlanarBlock(FPlanarBlock& OutBlock, const FPreciseBlock& InBlock)
+{
+	for (size_t i = 0; i < MAX_BLOCK_PIXELS; i++) {
+		OutBlock.R[i] = static_cast<float>(InBlock.Data[i].R);
+		OutBlock.G[i] = static_cast<float>(InBlock.Data[i].G);
+		OutBlock.B[i] = static_cast<float>(InBlock.Data[i].B);
+		OutBlock.A[i] = static_cast<float>(InBlock.Data[i].A);
+	}
+}
+
+static FORCEINLINE void EncodePlanarBlock(FDXT1& OutBlock, const FPlanarBlock& InBlock, const DXTEncoder::FEncodeOptions& Options)
+{
+	DXTEncoder::EncodeDXT1(OutBlock, InBlock, Options);
+}
+
+static FORCEINLINE void EncodePlanarBlock(FDXT5& OutBlock, const FPlanarBlock& InBlock, const DXTEncoder::FEncodeOptions& Options)
+{
+	DXTEncoder::EncodeDXT5(OutBlock, InBlock, Options);
+}
 
 template<typename NativeBlockType>
 struct BlockMapper::MapperModel : BlockMapper::MapperConcept
 {
-	MapperModel(UTexture2D* Texture, const int32 MipIdx) :
-		Texture(Texture), MipIdx(MipIdx), Format(Texture->GetPixelFormat()),
+	MapperModel(const FMipMemory& Memory, const FString& InName, TArray64<uint8>&& InSnapshot, TFunction<void()>&& InOnRelease) :
+		Name(InName), Format(Memory.Format),
 		BlockSideX(GPixelFormats[Format].BlockSizeX),
 		BlockSideY(GPixelFormats[Format].BlockSizeY),
-		SizeX(Texture->GetPlatformData()->Mips[MipIdx].SizeX),
-		OldBulkDataFlags(Texture->GetPlatformData()->Mips[MipIdx].BulkData.GetBulkDataFlags())
+		SizeX(Memory.SizeX),
+		SizeY(Memory.SizeY),
+		PaddedX(Align(SizeX, MAX_BLOCK_SIDE)),
+		PaddedY(Align(SizeY, MAX_BLOCK_SIDE)),
+		Data(reinterpret_cast<NativeBlockType*>(Memory.Data)),
+		Snapshot(MoveTemp(InSnapshot)),
+		OnRelease(MoveTemp(InOnRelease)),
+		bWritable(Memory.Access == EMipAccess::ReadWrite)
 	{
-		Texture->SetForceMipLevelsToBeResident(3600, 0);
-		Texture->WaitForStreaming(true, false);
-
-		FTexture2DMipMap* Mip = &Texture->GetPlatformData()->Mips[MipIdx];
-		Mip->BulkData.ClearBulkDataFlags(BULKDATA_AlwaysAllowDiscard | BULKDATA_SingleUse);
+		fgcheck(Data);
+		fgcheckf(Memory.NumBytes >= GetNumNativeBytes(), TEXT("%s holds %lld bytes, a %llu x %llu mip of %s needs %d"), *Name, Memory.NumBytes, (uint64)SizeX, (uint64)SizeY, GetPixelFormatString(Format), GetNumNativeBytes());
 	}
+	MapperModel(const MapperModel&) = delete;
+	MapperModel& operator=(const MapperModel&) = delete;
 
 	void DecodeBlock(FPreciseBlock& OutBlock, const NativeBlockType& InBlock, const size_t Offset) const
 	{
@@ -31,58 +93,302 @@ struct BlockMapper::MapperModel : BlockMapper::MapperConcept
 		return NativeBlockType();
 	}
 
-	virtual FPreciseBlock ReadBlock(size_t x, size_t y) const override
+	FORCEINLINE void CheckRegion(size_t x, size_t y, size_t w, size_t h, size_t NumBlocks) const
 	{
-		const FTexture2DMipMap* Mip = &Texture->GetPlatformData()->Mips[MipIdx];
-		const NativeBlockType* Src = reinterpret_cast<const NativeBlockType*>(Mip->BulkData.LockReadOnly());
-		fgcheck(Src);
+		fgcheckf(x % MAX_BLOCK_SIDE == 0 and y % MAX_BLOCK_SIDE == 0, TEXT("Region origin is not block-aligned"));
+		fgcheckf(w % MAX_BLOCK_SIDE == 0 and h % MAX_BLOCK_SIDE == 0, TEXT("Region extent is not block-aligned"));
+		fgcheckf(x + w <= SizeX and y + h <= SizeY, TEXT("Region exceeds the size of %s"), *Name);
+		fgcheckf(NumBlocks == (w / MAX_BLOCK_SIDE) * (h / MAX_BLOCK_SIDE), TEXT("Region block count mismatch"));
+	}
+
+	FORCEINLINE int32 GetNumNativeBytes() const
+	{
+		return static_cast<int32>(FMath::DivideAndRoundUp(SizeX, BlockSideX) * FMath::DivideAndRoundUp(SizeY, BlockSideY) * sizeof(NativeBlockType));
+	}
+
+	/* Mips smaller than 4x4 of a format with 1x1 blocks, those cannot be mapped as whole blocks */
+	FORCEINLINE bool IsLinearTail() const
+	{
+		return BlockSideX == 1 and (SizeX != PaddedX or SizeY != PaddedY);
+	}
+
+	/* Native block holding the i-th pixel of the 4x4 block at (x, y) */
+	FORCEINLINE size_t NativeOffset(size_t x, size_t y, size_t i) const
+	{
+		const size_t SubBlockNum = BlockSideX * BlockSideY;
+		const size_t h = i / MAX_BLOCK_SIDE;
+		const size_t w = i % MAX_BLOCK_SIDE;
+		return ((y + h) * PaddedX + (x + w) * BlockSideX) / SubBlockNum;
+	}
+
+	virtual void ReadRegion(size_t x, size_t y, size_t w, size_t h, TArrayView<FPreciseBlock> OutBlocks) const override
+	{
+		CheckRegion(x, y, w, h, OutBlocks.Num());
 
 		const size_t PreciseBlockNum = MAX_BLOCK_SIDE * MAX_BLOCK_SIDE;
 		const size_t SubBlockNum = BlockSideX * BlockSideY;
 
-		FPreciseBlock Dst;
-		for (size_t i = 0; i < PreciseBlockNum; i += SubBlockNum) {
-			const size_t h = i / MAX_BLOCK_SIDE;
-			const size_t w = i % MAX_BLOCK_SIDE;
-			const size_t Offset = ((y + h) * SizeX + (x + w) * BlockSideX) / SubBlockNum;
-			DecodeBlock(Dst, Src[Offset], i);
+		FPreciseBlock* Dst = OutBlocks.GetData();
+		for (size_t by = y; by < y + h; by += MAX_BLOCK_SIDE) {
+			for (size_t bx = x; bx < x + w; bx += MAX_BLOCK_SIDE) {
+				for (size_t i = 0; i < PreciseBlockNum; i += SubBlockNum) {
+					DecodeBlock(*Dst, Data[NativeOffset(bx, by, i)], i);
+				}
+				Dst++;
+			}
 		}
-		Mip->BulkData.Unlock();
-		return Dst;
 	}
 
-	virtual void WriteBlock(size_t x, size_t y, const FPreciseBlock& InBlock) override
+	virtual void WriteRegion(size_t x, size_t y, size_t w, size_t h, TArrayView<const FPreciseBlock> InBlocks) override
 	{
-		FTexture2DMipMap* Mip = &Texture->GetPlatformData()->Mips[MipIdx];
-		NativeBlockType* Dst = reinterpret_cast<NativeBlockType*>(Mip->BulkData.Lock(LOCK_READ_WRITE));
-		fgcheck(Dst);
+		fgcheckf(bWritable, TEXT("%s was mapped read-only"), *Name);
+		CheckRegion(x, y, w, h, InBlocks.Num());
 
 		const size_t PreciseBlockNum = MAX_BLOCK_SIDE * MAX_BLOCK_SIDE;
 		const size_t SubBlockNum = BlockSideX * BlockSideY;
 
-		for (size_t i = 0; i < PreciseBlockNum; i += SubBlockNum) {
-			const size_t h = i / MAX_BLOCK_SIDE;
-			const size_t w = i % MAX_BLOCK_SIDE;
-			const size_t Offset = ((y + h) * SizeX + (x + w) * BlockSideX) / SubBlockNum;
-			Dst[Offset] = EncodeBlock(InBlock, i);
+		const FPreciseBlock* Src = InBlocks.GetData();
+		for (size_t by = y; by < y + h; by += MAX_BLOCK_SIDE) {
+			for (size_t bx = x; bx < x + w; bx += MAX_BLOCK_SIDE) {
+				for (size_t i = 0; i < PreciseBlockNum; i += SubBlockNum) {
+					Data[NativeOffset(bx, by, i)] = EncodeBlock(*Src, i);
+				}
+				Src++;
+			}
 		}
-		Mip->BulkData.Unlock();
+	}
+
+	/* Linear pixel formats map the four pixel rows of a block row directly */
+	template<typename PolicyT>
+	void DecodeRowPlanar(size_t y, TPlanarMip<PolicyT>& OutMip, TArray<FPreciseBlock>& Scratch) const
+	{
+		const size_t NumBlocksX = PaddedX / MAX_BLOCK_SIDE;
+		const size_t Begin = y * PaddedX;
+		const size_t End = Begin + MAX_BLOCK_SIDE * PaddedX;
+		if constexpr (std::is_same_v<NativeBlockType, FColor>) {
+			for (size_t Idx = Begin; Idx < End; Idx++) {
+				const FColor Color = Data[Idx];
+				OutMip.R()[Idx] = PolicyT::FromUnorm8(Color.R);
+				OutMip.G()[Idx] = PolicyT::FromUnorm8(Color.G);
+				OutMip.B()[Idx] = PolicyT::FromUnorm8(Color.B);
+				OutMip.A()[Idx] = PolicyT::FromUnorm8(Color.A);
+			}
+		} else if constexpr (std::is_same_v<NativeBlockType, FFloat16Color>) {
+			for (size_t Idx = Begin; Idx < End; Idx++) {
+				const FFloat16Color& Color = Data[Idx];
+				OutMip.R()[Idx] = PolicyT::FromFloat(Color.R.GetFloat());
+				OutMip.G()[Idx] = PolicyT::FromFloat(Color.G.GetFloat());
+				OutMip.B()[Idx] = PolicyT::FromFloat(Color.B.GetFloat());
+				OutMip.A()[Idx] = PolicyT::FromFloat(Color.A.GetFloat());
+			}
+		} else if constexpr (std::is_same_v<NativeBlockType, FDXT1> or std::is_same_v<NativeBlockType, FDXT5> or IS_DECODE_ONLY_BLOCK<NativeBlockType>) {
+			const NativeBlockType* Row = &Data[NativeOffset(0, y, 0)];
+			FPlanarBlock Block;
+			for (size_t bx = 0; bx < NumBlocksX; bx++) {
+				DecodePlanarBlock(Block, Row[bx]);
+				StorePlanarBlock(OutMip, Block, bx * MAX_BLOCK_SIDE, y);
+			}
+		} else {
+			/* Generic path through precise blocks */
+			Scratch.SetNumUninitialized(NumBlocksX);
+			ReadRegion(0, y, SizeX, MAX_BLOCK_SIDE, Scratch);
+			for (size_t bx = 0; bx < NumBlocksX; bx++) {
+				for (size_t i = 0; i < MAX_BLOCK_PIXELS; i++) {
+					const size_t Idx = (y + i / MAX_BLOCK_SIDE) * SizeX + bx * MAX_BLOCK_SIDE + i % MAX_BLOCK_SIDE;
+					const FPreciseColor& Color = Scratch[bx].Data[i];
+					OutMip.R()[Idx] = PolicyT::FromDouble(Color.R);
+					OutMip.G()[Idx] = PolicyT::FromDouble(Color.G);
+					OutMip.B()[Idx] = PolicyT::FromDouble(Color.B);
+					OutMip.A()[Idx] = PolicyT::FromDouble(Color.A);
+				}
+			}
+		}
+	}
+
+	template<typename PolicyT>
+	void EncodeRowPlanar(size_t y, const TPlanarMip<PolicyT>& InMip, TConstArrayView<bool> SkipBlocks, TArray<FPreciseBlock>& Scratch)
+	{
+		const size_t NumBlocksX = PaddedX / MAX_BLOCK_SIDE;
+		const size_t Begin = y * PaddedX;
+		const size_t End = Begin + MAX_BLOCK_SIDE * PaddedX;
+		if constexpr (std::is_same_v<NativeBlockType, FColor>) {
+			for (size_t Idx = Begin; Idx < End; Idx++) {
+				Data[Idx] = FColor(
+					PolicyT::ToUnorm8(InMip.R()[Idx], false),
+					PolicyT::ToUnorm8(InMip.G()[Idx], false),
+					PolicyT::ToUnorm8(InMip.B()[Idx], false),
+					PolicyT::ToUnorm8(InMip.A()[Idx], false));
+			}
+		} else if constexpr (std::is_same_v<NativeBlockType, FDXT1> or std::is_same_v<NativeBlockType, FDXT5>) {
+			NativeBlockType* Row = &Data[NativeOffset(0, y, 0)];
+			const bool* SkipRow = SkipBlocks.IsEmpty() ? nullptr : &SkipBlocks[(y / MAX_BLOCK_SIDE) * NumBlocksX];
+			FPlanarBlock Block;
+			for (size_t bx = 0; bx < NumBlocksX; bx++) {
+				if (SkipRow and SkipRow[bx]) {
+					continue;
+				}
+				LoadPlanarBlock(Block, InMip, bx * MAX_BLOCK_SIDE, y);
+				EncodePlanarBlock(Row[bx], Block, EncodeOptions);
+			}
+		} else {
+			/* Generic path through precise blocks */
+			Scratch.SetNumUninitialized(NumBlocksX);
+			for (size_t bx = 0; bx < NumBlocksX; bx++) {
+				for (size_t i = 0; i < MAX_BLOCK_PIXELS; i++) {
+					const size_t Idx = (y + i / MAX_BLOCK_SIDE) * SizeX + bx * MAX_BLOCK_SIDE + i % MAX_BLOCK_SIDE;
+					Scratch[bx].Data[i] = FPreciseColor(
+						PolicyT::ToDouble(InMip.R()[Idx]),
+						PolicyT::ToDouble(InMip.G()[Idx]),
+						PolicyT::ToDouble(InMip.B()[Idx]),
+						PolicyT::ToDouble(InMip.A()[Idx]));
+				}
+			}
+			WriteRegion(0, y, SizeX, MAX_BLOCK_SIDE, Scratch);
+		}
+	}
+
+	/* Repeats the last row and column into the padding, so that the planar mip is whole blocks */
+	template<typename PolicyT>
+	void DecodeLinearTail(TPlanarMip<PolicyT>& OutMip) const
+	{
+		for (size_t y = 0; y < PaddedY; y++) {
+			for (size_t x = 0; x < PaddedX; x++) {
+				const NativeBlockType& Color = Data[FMath::Min(y, SizeY - 1) * SizeX + FMath::Min(x, SizeX - 1)];
+				const size_t Idx = y * PaddedX + x;
+				if constexpr (std::is_same_v<NativeBlockType, FColor>) {
+					OutMip.R()[Idx] = PolicyT::FromUnorm8(Color.R);
+					OutMip.G()[Idx] = PolicyT::FromUnorm8(Color.G);
+					OutMip.B()[Idx] = PolicyT::FromUnorm8(Color.B);
+					OutMip.A()[Idx] = PolicyT::FromUnorm8(Color.A);
+				} else if constexpr (std::is_same_v<NativeBlockType, FFloat16Color>) {
+					OutMip.R()[Idx] = PolicyT::FromFloat(Color.R.GetFloat());
+					OutMip.G()[Idx] = PolicyT::FromFloat(Color.G.GetFloat());
+					OutMip.B()[Idx] = PolicyT::FromFloat(Color.B.GetFloat());
+					OutMip.A()[Idx] = PolicyT::FromFloat(Color.A.GetFloat());
+				}
+			}
+		}
+	}
+
+	/* Drops the padding */
+	template<typename PolicyT>
+	void EncodeLinearTail(const TPlanarMip<PolicyT>& InMip)
+	{
+		if constexpr (std::is_same_v<NativeBlockType, FColor>) {
+			for (size_t y = 0; y < SizeY; y++) {
+				for (size_t x = 0; x < SizeX; x++) {
+					const size_t Idx = y * PaddedX + x;
+					Data[y * SizeX + x] = FColor(
+						PolicyT::ToUnorm8(InMip.R()[Idx], false),
+						PolicyT::ToUnorm8(InMip.G()[Idx], false),
+						PolicyT::ToUnorm8(InMip.B()[Idx], false),
+						PolicyT::ToUnorm8(InMip.A()[Idx], false));
+				}
+			}
+		} else {
+			fgcheckf(false, TEXT("%s is unimplemented for %s"), *FString(__func__), GetPixelFormatString(Format));
+		}
+	}
+
+	/* Block rows touch disjoint memory, so they are spread over the task graph */
+	static FORCEINLINE EParallelForFlags GetRowFlags(const int32 NumRows)
+	{
+		return NumRows < MIN_PARALLEL_ROWS ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None;
+	}
+
+	template<typename PolicyT>
+	void DecodeMipImpl(TPlanarMip<PolicyT>& OutMip) const
+	{
+		OutMip.Init(PaddedX, PaddedY);
+		if (IsLinearTail()) {
+			DecodeLinearTail(OutMip);
+			return;
+		}
+		const int32 NumRows = PaddedY / MAX_BLOCK_SIDE;
+		ParallelFor(NumRows, [&](const int32 Row) {
+			TArray<FPreciseBlock> Scratch;
+			DecodeRowPlanar(Row * MAX_BLOCK_SIDE, OutMip, Scratch);
+		}, GetRowFlags(NumRows));
+	}
+
+	template<typename PolicyT>
+	void EncodeMipImpl(const TPlanarMip<PolicyT>& InMip, TConstArrayView<bool> SkipBlocks)
+	{
+		fgcheckf(bWritable, TEXT("%s was mapped read-only"), *Name);
+		fgcheckf(InMip.SizeX == PaddedX and InMip.SizeY == PaddedY, TEXT("Planar mip is %d x %d, but %s is %llu x %llu"), InMip.SizeX, InMip.SizeY, *Name, (uint64)SizeX, (uint64)SizeY);
+		fgcheckf(SkipBlocks.IsEmpty() or SkipBlocks.Num() == (PaddedX / MAX_BLOCK_SIDE) * (PaddedY / MAX_BLOCK_SIDE), TEXT("Skip mask does not match %s"), *Name);
+		if (IsLinearTail()) {
+			EncodeLinearTail(InMip);
+			return;
+		}
+		const int32 NumRows = PaddedY / MAX_BLOCK_SIDE;
+		ParallelFor(NumRows, [&](const int32 Row) {
+			TArray<FPreciseBlock> Scratch;
+			EncodeRowPlanar(Row * MAX_BLOCK_SIDE, InMip, SkipBlocks, Scratch);
+		}, GetRowFlags(NumRows));
+	}
+
+	virtual void DecodeMip(TPlanarMip<FDoublePrecision>& OutMip) const override { DecodeMipImpl(OutMip); }
+	virtual void DecodeMip(TPlanarMip<FFloatPrecision>& OutMip) const override { DecodeMipImpl(OutMip); }
+	virtual void DecodeMip(TPlanarMip<FFixed16Precision>& OutMip) const override { DecodeMipImpl(OutMip); }
+	virtual void EncodeMip(const TPlanarMip<FDoublePrecision>& InMip, TConstArrayView<bool> SkipBlocks) override { EncodeMipImpl(InMip, SkipBlocks); }
+	virtual void EncodeMip(const TPlanarMip<FFloatPrecision>& InMip, TConstArrayView<bool> SkipBlocks) override { EncodeMipImpl(InMip, SkipBlocks); }
+	virtual void EncodeMip(const TPlanarMip<FFixed16Precision>& InMip, TConstArrayView<bool> SkipBlocks) override { EncodeMipImpl(InMip, SkipBlocks); }
+
+	virtual void SetEncodeOptions(const DXTEncoder::FEncodeOptions& Options) override
+	{
+		EncodeOptions = Options;
+	}
+
+	virtual TConstArrayView<uint8> GetNativeBytes() const override
+	{
+		return TConstArrayView<uint8>(reinterpret_cast<const uint8*>(Data), GetNumNativeBytes());
+	}
+
+	virtual TArrayView<uint8> GetMutableNativeBytes() override
+	{
+		fgcheckf(bWritable, TEXT("%s was mapped read-only"), *Name);
+		return TArrayView<uint8>(reinterpret_cast<uint8*>(Data), GetNumNativeBytes());
+	}
+
+	virtual EPixelFormat GetPixelFormat() const override
+	{
+		return Format;
+	}
+
+	virtual size_t GetSizeX() const override
+	{
+		return SizeX;
+	}
+
+	virtual size_t GetSizeY() const override
+	{
+		return SizeY;
 	}
 private:
 	virtual void OnDestruction() override
 	{
-		FTexture2DMipMap* Mip = &Texture->GetPlatformData()->Mips[MipIdx];
-		Mip->BulkData.ResetBulkDataFlags(OldBulkDataFlags);
-		Texture->SetForceMipLevelsToBeResident(0, 0);
+		if (OnRelease) {
+			Invoke(OnRelease);
+		}
 	}
 
-	UTexture2D* Texture;
-	const int32 MipIdx;
+	/* For messages only */
+	const FString Name;
 	const EPixelFormat Format;
 	const size_t BlockSideX;
 	const size_t BlockSideY;
 	const size_t SizeX;
-	const uint32 OldBulkDataFlags;
+	const size_t SizeY;
+	/* Planar mips are always whole 4x4 blocks, see PlanarMip.h */
+	const size_t PaddedX;
+	const size_t PaddedY;
+	NativeBlockType* Data = nullptr;
+	/* What Data points into for read-only texture mips */
+	TArray64<uint8> Snapshot;
+	TFunction<void()> OnRelease;
+	bool bWritable = false;
+	DXTEncoder::FEncodeOptions EncodeOptions;
 };
 
 static FORCEINLINE FPreciseColor GetDXT1Color(const FPreciseColor& Color0, const FPreciseColor& Color1, const uint8_t Code, const bool bUseThirds = true)
@@ -144,11 +450,15 @@ template<> void BlockMapper::MapperModel<FDXT1>::DecodeBlock(FPreciseBlock& OutB
 
 	const FPreciseColor Color0(InBlock.Color[0]);
 	const FPreciseColor Color1(InBlock.Color[1]);
+	const bool bUseThirds = InBlock.Color[0].Value > InBlock.Color[1].Value;
+
+	FPreciseColor Palette[4];
+	Th3Utilities::StaticFor<0, 4>()([&](size_t Code) {
+		Palette[Code] = GetDXT1Color(Color0, Color1, Code, bUseThirds);
+	});
 
-	Th3Utilities::StaticFor<0, DXT1_NUM_PIXELS>()([=, &OutBlock](size_t i) {
-		const bool bUseThirds = InBlock.Color[0].Value > InBlock.Color[1].Value;
-		const uint8_t ColorCode = (InBlock.Indices >> (2 * i)) & 0x03;
-		OutBlock.Data[i] = GetDXT1Color(Color0, Color1, ColorCode, bUseThirds);
+	Th3Utilities::StaticFor<0, DXT1_NUM_PIXELS>()([&](size_t i) {
+		OutBlock.Data[i] = Palette[(InBlock.Indices >> (2 * i)) & 0x03];
 	});
 }
 
@@ -159,21 +469,68 @@ template<> void BlockMapper::MapperModel<FDXT5>::DecodeBlock(FPreciseBlock& OutB
 	const FPreciseColor Color0(InBlock.DXT1.Color[0]);
 	const FPreciseColor Color1(InBlock.DXT1.Color[1]);
 
-	uint64_t AlphaBits = 0;
-	const uint8_t* Bits = &InBlock.Alpha[2];
-	Th3Utilities::StaticFor<0, 6>()([&AlphaBits, Bits](size_t i) {
-		const uint64_t Mask = Bits[i];
-		AlphaBits |= Mask << (8 * i);
+	FPreciseColor Palette[4];
+	double AlphaPalette[8];
+	Th3Utilities::StaticFor<0, 4>()([&](size_t Code) {
+		Palette[Code] = GetDXT1Color(Color0, Color1, Code);
 	});
+	Th3Utilities::StaticFor<0, 8>()([&](size_t Code) {
+		AlphaPalette[Code] = GetDXT5Alpha(InBlock.Alpha[0], InBlock.Alpha[1], Code) / 255.0;
+	});
+
+	const uint64 AlphaBits = DXTDecoder::GetAlphaIndices(InBlock);
 
-	Th3Utilities::StaticFor<0, DXT5_NUM_PIXELS>()([=, &OutBlock](size_t i) {
+	Th3Utilities::StaticFor<0, DXT5_NUM_PIXELS>()([&](size_t i) {
 		const uint8_t ColorCode = (InBlock.DXT1.Indices >> (2 * i)) & 0x03;
 		const uint8_t AlphaCode = (AlphaBits >> (3 * i)) & 0x07;
-		const double FloatAlpha = GetDXT5Alpha(InBlock.Alpha[0], InBlock.Alpha[1], AlphaCode) / 255.0;
-		OutBlock.Data[i] = GetDXT1Color(Color0, Color1, ColorCode).WithAlpha(FloatAlpha);
+		OutBlock.Data[i] = Palette[ColorCode].WithAlpha(AlphaPalette[AlphaCode]);
 	});
 }
 
+/* No reference decoder for these, the precise blocks come from the planar one */
+template<typename NativeBlockType>
+static FORCEINLINE void DecodePreciseBlock(FPreciseBlock& OutBlock, const NativeBlockType& InBlock)
+{
+	FPlanarBlock Block;
+	DecodePlanarBlock(Block, InBlock);
+	for (size_t i = 0; i < MAX_BLOCK_PIXELS; i++) {
+		OutBlock.Data[i] = FPreciseColor(Block.R[i], Block.G[i], Block.B[i], Block.A[i]);
+	}
+}
+
+template<> void BlockMapper::MapperModel<FBC4>::DecodeBlock(FPreciseBlock& OutBlock, const FBC4& InBlock, const size_t Offset) const
+{
+	DecodePreciseBlock(OutBlock, InBlock);
+}
+
+template<> void BlockMapper::MapperModel<FBC5>::DecodeBlock(FPreciseBlock& OutBlock, const FBC5& InBlock, const size_t Offset) const
+{
+	DecodePreciseBlock(OutBlock, InBlock);
+}
+
+template<> void BlockMapper::MapperModel<FBC7>::DecodeBlock(FPreciseBlock& OutBlock, const FBC7& InBlock, const size_t Offset) const
+{
+	DecodePreciseBlock(OutBlock, InBlock);
+}
+
+template<> FDXT1 BlockMapper::MapperModel<FDXT1>::EncodeBlock(const FPreciseBlock& InBlock, const size_t Offset) const
+{
+	FPlanarBlock Block;
+	LoadPlanarBlock(Block, InBlock);
+	FDXT1 OutBlock;
+	EncodePlanarBlock(OutBlock, Block, EncodeOptions);
+	return OutBlock;
+}
+
+template<> FDXT5 BlockMapper::MapperModel<FDXT5>::EncodeBlock(const FPreciseBlock& InBlock, const size_t Offset) const
+{
+	FPlanarBlock Block;
+	LoadPlanarBlock(Block, InBlock);
+	FDXT5 OutBlock;
+	EncodePlanarBlock(OutBlock, Block, EncodeOptions);
+	return OutBlock;
+}
+
 template<> void BlockMapper::MapperModel<FFloat16Color>::DecodeBlock(FPreciseBlock& OutBlock, const FFloat16Color& InBlock, const size_t Offset) const
 {
 	OutBlock.Data[Offset] = FPreciseColor(InBlock);
@@ -189,23 +546,79 @@ template<> FColor BlockMapper::MapperModel<FColor>::EncodeBlock(const FPreciseBl
 	return InBlock.Data[Offset].ToFColor(false);
 }
 
-TSharedPtr<BlockMapper::MapperConcept> BlockMapper::MakeMapper(UTexture2D* Texture, const int32 MipIdx)
+TSharedPtr<BlockMapper::MapperConcept> BlockMapper::MakeMapper(const FMipMemory& Memory, const FString& Name, TArray64<uint8>&& Snapshot, TFunction<void()>&& OnRelease)
 {
-	fgcheck(Texture);
-	const int32 NumMips = Texture->GetNumMipsAllowed(false);
-	fgcheckf(MipIdx < NumMips, TEXT("Requested mip %d, but texture %s only has %d mips"), MipIdx, *Texture->GetPathName(), NumMips);
-	const EPixelFormat Format = Texture->GetPixelFormat();
-	switch (Format) {
+	switch (Memory.Format) {
 	case EPixelFormat::PF_DXT1:
-		return MakeShared<MapperModel<FDXT1>>(MapperModel<FDXT1>(Texture, MipIdx));
+		return MakeShared<MapperModel<FDXT1>>(Memory, Name, MoveTemp(Snapshot), MoveTemp(OnRelease));
 	case EPixelFormat::PF_DXT5:
-		return MakeShared<MapperModel<FDXT5>>(MapperModel<FDXT5>(Texture, MipIdx));
+		return MakeShared<MapperModel<FDXT5>>(Memory, Name, MoveTemp(Snapshot), MoveTemp(OnRelease));
 	case EPixelFormat::PF_B8G8R8A8:
-		return MakeShared<MapperModel<FColor>>(MapperModel<FColor>(Texture, MipIdx));
+		return MakeShared<MapperModel<FColor>>(Memory, Name, MoveTemp(Snapshot), MoveTemp(OnRelease));
 	case EPixelFormat::PF_FloatRGBA:
-		return MakeShared<MapperModel<FFloat16Color>>(MapperModel<FFloat16Color>(Texture, MipIdx));
+		return MakeShared<MapperModel<FFloat16Color>>(Memory, Name, MoveTemp(Snapshot), MoveTemp(OnRelease));
+	case EPixelFormat::PF_BC4:
+		return MakeShared<MapperModel<FBC4>>(Memory, Name, MoveTemp(Snapshot), MoveTemp(OnRelease));
+	case EPixelFormat::PF_BC5:
+		return MakeShared<MapperModel<FBC5>>(Memory, Name, MoveTemp(Snapshot), MoveTemp(OnRelease));
+	case EPixelFormat::PF_BC7:
+		return MakeShared<MapperModel<FBC7>>(Memory, Name, MoveTemp(Snapshot), MoveTemp(OnRelease));
 	default:
-		fgcheckf(false, TEXT("Unsupported format %s, cannot create a block mapper for texture %s"), GetPixelFormatString(Format), *Texture->GetPathName());
+		fgcheckf(false, TEXT("Unsupported format %s, cannot create a block mapper for %s"), GetPixelFormatString(Memory.Format), *Name);
 		return nullptr;
 	}
 }
+
+/* Game thread: only this knows about textures and bulk data, the mapper itself just gets the memory */
+TSharedPtr<BlockMapper::MapperConcept> BlockMapper::MakeMapper(UTexture2D* Texture, const int32 MipIdx, const EMipAccess Access)
+{
+	fgcheck(Texture);
+	const int32 NumMips = Texture->GetNumMipsAllowed(false);
+	fgcheckf(MipIdx < NumMips, TEXT("Requested mip %d, but texture %s only has %d mips"), MipIdx, *Texture->GetPathName(), NumMips);
+	FTexture2DMipMap* Mip = &Texture->GetPlatformData()->Mips[MipIdx];
+	const uint32 OldBulkDataFlags = Mip->BulkData.GetBulkDataFlags();
+	const FString Name = FString::Printf(TEXT("mip %d of %s"), MipIdx, *Texture->GetPathName());
+
+	FMipMemory Memory = {
+		.NumBytes = Mip->BulkData.GetBulkDataSize(),
+		.SizeX = Mip->SizeX,
+		.SizeY = Mip->SizeY,
+		.Format = Texture->GetPixelFormat(),
+		.Access = Access,
+	};
+	if (Access == EMipAccess::ReadOnly) {
+		/* Batches stream their sources in up front, see TextureResidency.h */
+		const bool bStreamIn = not FTextureResidency::IsPinned(Texture);
+		if (bStreamIn) {
+			Texture->SetForceMipLevelsToBeResident(3600, 0);
+			Texture->WaitForStreaming(true, false);
+		}
+		Mip->BulkData.ClearBulkDataFlags(BULKDATA_AlwaysAllowDiscard | BULKDATA_SingleUse);
+
+		/* Copy out and let go of the lock, the snapshot can then be read from any thread */
+		TArray64<uint8> Snapshot;
+		Snapshot.SetNumUninitialized(Memory.NumBytes);
+		const void* Src = Mip->BulkData.LockReadOnly();
+		fgcheck(Src);
+		FMemory::Memcpy(Snapshot.GetData(), Src, Memory.NumBytes);
+		Mip->BulkData.Unlock();
+		Mip->BulkData.ResetBulkDataFlags(OldBulkDataFlags);
+		if (bStreamIn) {
+			Texture->SetForceMipLevelsToBeResident(0, 0);
+		}
+		/* Moving the array keeps its allocation, so Data stays valid */
+		Memory.Data = Snapshot.GetData();
+		return MakeMapper(Memory, Name, MoveTemp(Snapshot), nullptr);
+	}
+
+	/* Only textures generated here are written to, those never stream */
+	Mip->BulkData.ClearBulkDataFlags(BULKDATA_AlwaysAllowDiscard | BULKDATA_SingleUse);
+
+	/* Lock once, the lock is only released when the mapper goes away */
+	Memory.Data = static_cast<uint8*>(Mip->BulkData.Lock(LOCK_READ_WRITE));
+	return MakeMapper(Memory, Name, {}, [Texture, MipIdx, OldBulkDataFlags]() {
+		FTexture2DMipMap* Mip = &Texture->GetPlatformData()->Mips[MipIdx];
+		Mip->BulkData.Unlock();
+		Mip->BulkData.ResetBulkDataFlags(OldBulkDataFlags);
+	});
+}
@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#include "ColorPrecision.h"
+
+struct FUnorm8Lut16
+{
+	uint8 Data[0x10000];
+
+	explicit FUnorm8Lut16(const bool bSRGB)
+	{
+		for (int32 i = 0; i < 0x10000; i++) {
+			Data[i] = ColorPrecision::QuantizeUnorm8(i / 65535.0f, bSRGB);
+		}
+	}
+};
+
+const uint8* ColorPrecision::GetLinearLut16()
+{
+	static const FUnorm8Lut16 Lut(false);
+	return Lut.Data;
+}
+
+const uint8* ColorPrecision::GetSRGBLut16()
+{
+	static const FUnorm8Lut16 Lut(true);
+	return Lut.Data;
+}
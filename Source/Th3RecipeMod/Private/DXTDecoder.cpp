@@ -0,0 +1,199 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#include "DXTDecoder.h"
+
+/*
+ * Palette entries are integer sums of the 8-bit endpoints, divided once in
+ * float. That is the correctly rounded quotient, which for every endpoint
+ * pair is also what the FPreciseColor path in double rounds to. Each entry
+ * is Weight0 * Endpoint0 + Weight1 * Endpoint1 + Bias over Divisor, so
+ * that the loops below compile to a few vector converts and divides.
+ */
+template<int32 NumEntries>
+struct FPaletteWeights
+{
+	int32 Weight0[NumEntries];
+	int32 Weight1[NumEntries];
+	int32 Bias[NumEntries];
+	float Divisor[NumEntries];
+};
+
+/* Two thirds and one third, or the midpoint and transparent black, like FPreciseColor::Average */
+static constexpr FPaletteWeights<4> FOUR_COLOR_WEIGHTS = { { 1, 0, 2, 1 }, { 0, 1, 1, 2 }, { 0, 0, 0, 0 }, { 255.0f, 255.0f, 765.0f, 765.0f } };
+static constexpr FPaletteWeights<4> THREE_COLOR_WEIGHTS = { { 1, 0, 1, 0 }, { 0, 1, 1, 0 }, { 0, 0, 0, 0 }, { 255.0f, 255.0f, 510.0f, 510.0f } };
+
+/* Six interpolated alphas, or four plus 0 and 0xff */
+static constexpr FPaletteWeights<8> EIGHT_ALPHA_WEIGHTS = {
+	{ 1, 0, 6, 5, 4, 3, 2, 1 },
+	{ 0, 1, 1, 2, 3, 4, 5, 6 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 255.0f, 255.0f, 1785.0f, 1785.0f, 1785.0f, 1785.0f, 1785.0f, 1785.0f },
+};
+static constexpr FPaletteWeights<8> SIX_ALPHA_WEIGHTS = {
+	{ 1, 0, 4, 3, 2, 1, 0, 0 },
+	{ 0, 1, 1, 2, 3, 4, 0, 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 255 },
+	{ 255.0f, 255.0f, 1275.0f, 1275.0f, 1275.0f, 1275.0f, 255.0f, 255.0f },
+};
+
+template<int32 NumEntries>
+static FORCEINLINE void Interpolate(float* RESTRICT OutEntries, const FPaletteWeights<NumEntries>& Weights, const int32 Endpoint0, const int32 Endpoint1)
+{
+	for (int32 i = 0; i < NumEntries; i++) {
+		OutEntries[i] = static_cast<float>(Weights.Weight0[i] * Endpoint0 + Weights.Weight1[i] * Endpoint1 + Weights.Bias[i]) / Weights.Divisor[i];
+	}
+}
+
+void DXTDecoder::BuildColorPalette(FColorPalette& OutPalette, const FDXT1& InBlock, const bool bAllowThreeColors)
+{
+	const FDXTColor565 Color0 = InBlock.Color[0].Color565;
+	const FDXTColor565 Color1 = InBlock.Color[1].Color565;
+	const bool bUseThirds = not bAllowThreeColors or InBlock.Color[0].Value > InBlock.Color[1].Value;
+	const FPaletteWeights<4>& Weights = bUseThirds ? FOUR_COLOR_WEIGHTS : THREE_COLOR_WEIGHTS;
+
+	/* Same expansion as FPreciseColor(FDXTColor565), no low bit replication */
+	Interpolate(OutPalette.R, Weights, static_cast<uint8>(Color0.R << 3), static_cast<uint8>(Color1.R << 3));
+	Interpolate(OutPalette.G, Weights, static_cast<uint8>(Color0.G << 2), static_cast<uint8>(Color1.G << 2));
+	Interpolate(OutPalette.B, Weights, static_cast<uint8>(Color0.B << 3), static_cast<uint8>(Color1.B << 3));
+	Interpolate(OutPalette.A, Weights, 0xff, 0xff);
+}
+
+void DXTDecoder::BuildAlphaPalette(FAlphaPalette& OutPalette, const uint8 Alpha0, const uint8 Alpha1)
+{
+	Interpolate(OutPalette.A, Alpha0 > Alpha1 ? EIGHT_ALPHA_WEIGHTS : SIX_ALPHA_WEIGHTS, Alpha0, Alpha1);
+}
+
+uint64 DXTDecoder::GetAlphaIndices(const FDXT5& InBlock)
+{
+	/* The two endpoints and the 48 index bits are one little endian word */
+	uint64 AlphaBits;
+	FMemory::Memcpy(&AlphaBits, InBlock.Alpha, sizeof(AlphaBits));
+	return AlphaBits >> 16;
+}
+
+static FORCEINLINE void ExpandColorsScalar(FPlanarBlock& OutBlock, const DXTDecoder::FColorPalette& Palette, const uint32 Indices)
+{
+	for (int32 i = 0; i < 16; i++) {
+		const uint32 Code = (Indices >> (2 * i)) & 0x03;
+		OutBlock.R[i] = Palette.R[Code];
+		OutBlock.G[i] = Palette.G[Code];
+		OutBlock.B[i] = Palette.B[Code];
+		OutBlock.A[i] = Palette.A[Code];
+	}
+}
+
+static FORCEINLINE void ExpandAlphaScalar(FPlanarBlock& OutBlock, const DXTDecoder::FAlphaPalette& Palette, const uint64 AlphaBits)
+{
+	for (int32 i = 0; i < 16; i++) {
+		OutBlock.A[i] = Palette.A[(AlphaBits >> (3 * i)) & 0x07];
+	}
+}
+
+#if TH3_SIMD_AVX2
+/* Palette lookups are a single permute per 8 pixels and channel */
+static FORCEINLINE void ExpandColors(FPlanarBlock& OutBlock, const DXTDecoder::FColorPalette& Palette, const uint32 Indices, const bool bWithAlpha)
+{
+	const __m256i Shifts = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+	const __m256i Mask = _mm256_set1_epi32(0x03);
+	const __m256 PalR = _mm256_castps128_ps256(_mm_load_ps(Palette.R));
+	const __m256 PalG = _mm256_castps128_ps256(_mm_load_ps(Palette.G));
+	const __m256 PalB = _mm256_castps128_ps256(_mm_load_ps(Palette.B));
+	const __m256 PalA = _mm256_castps128_ps256(_mm_load_ps(Palette.A));
+	for (int32 i = 0; i < 16; i += 8) {
+		const __m256i Codes = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int32>(Indices >> (2 * i))), Shifts), Mask);
+		_mm256_store_ps(&OutBlock.R[i], _mm256_permutevar8x32_ps(PalR, Codes));
+		_mm256_store_ps(&OutBlock.G[i], _mm256_permutevar8x32_ps(PalG, Codes));
+		_mm256_store_ps(&OutBlock.B[i], _mm256_permutevar8x32_ps(PalB, Codes));
+		if (bWithAlpha) {
+			_mm256_store_ps(&OutBlock.A[i], _mm256_permutevar8x32_ps(PalA, Codes));
+		}
+	}
+}
+
+static FORCEINLINE void ExpandAlpha(FPlanarBlock& OutBlock, const DXTDecoder::FAlphaPalette& Palette, const uint64 AlphaBits)
+{
+	const __m256i Shifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	const __m256i Mask = _mm256_set1_epi32(0x07);
+	const __m256 PalA = _mm256_load_ps(Palette.A);
+	for (int32 i = 0; i < 16; i += 8) {
+		const int32 Bits = static_cast<int32>((AlphaBits >> (3 * i)) & 0xffffff);
+		const __m256i Codes = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(Bits), Shifts), Mask);
+		_mm256_store_ps(&OutBlock.A[i], _mm256_permutevar8x32_ps(PalA, Codes));
+	}
+}
+#elif TH3_SIMD_SSE2
+/*
+ * No variable permutes in SSE2. Transpose the palette to one RGBA entry per
+ * register, pick the entry of each pixel and transpose every four pixels
+ * back into planes. The alpha palette has eight entries, a table lookup
+ * per pixel is as fast as anything SSE2 can do there.
+ */
+static FORCEINLINE void ExpandColors(FPlanarBlock& OutBlock, const DXTDecoder::FColorPalette& Palette, const uint32 Indices, const bool bWithAlpha)
+{
+	__m128 Entries[4] = { _mm_load_ps(Palette.R), _mm_load_ps(Palette.G), _mm_load_ps(Palette.B), _mm_load_ps(Palette.A) };
+	_MM_TRANSPOSE4_PS(Entries[0], Entries[1], Entries[2], Entries[3]);
+	for (int32 i = 0; i < 16; i += 4) {
+		const uint32 Codes = Indices >> (2 * i);
+		__m128 R = Entries[Codes & 0x03];
+		__m128 G = Entries[(Codes >> 2) & 0x03];
+		__m128 B = Entries[(Codes >> 4) & 0x03];
+		__m128 A = Entries[(Codes >> 6) & 0x03];
+		_MM_TRANSPOSE4_PS(R, G, B, A);
+		_mm_store_ps(&OutBlock.R[i], R);
+		_mm_store_ps(&OutBlock.G[i], G);
+		_mm_store_ps(&OutBlock.B[i], B);
+		if (bWithAlpha) {
+			_mm_store_ps(&OutBlock.A[i], A);
+		}
+	}
+}
+
+static FORCEINLINE void ExpandAlpha(FPlanarBlock& OutBlock, const DXTDecoder::FAlphaPalette& Palette, const uint64 AlphaBits)
+{
+	ExpandAlphaScalar(OutBlock, Palette, AlphaBits);
+}
+#else
+static FORCEINLINE void ExpandColors(FPlanarBlock& OutBlock, const DXTDecoder::FColorPalette& Palette, const uint32 Indices, const bool bWithAlpha)
+{
+	ExpandColorsScalar(OutBlock, Palette, Indices);
+}
+
+static FORCEINLINE void ExpandAlpha(FPlanarBlock& OutBlock, const DXTDecoder::FAlphaPalette& Palette, const uint64 AlphaBits)
+{
+	ExpandAlphaScalar(OutBlock, Palette, AlphaBits);
+}
+#endif
+
+void DXTDecoder::DecodeDXT1Scalar(FPlanarBlock& OutBlock, const FDXT1& InBlock)
+{
+	FColorPalette Palette;
+	BuildColorPalette(Palette, InBlock, true);
+	ExpandColorsScalar(OutBlock, Palette, InBlock.Indices);
+}
+
+void DXTDecoder::DecodeDXT5Scalar(FPlanarBlock& OutBlock, const FDXT5& InBlock)
+{
+	FColorPalette Palette;
+	FAlphaPalette AlphaPalette;
+	BuildColorPalette(Palette, InBlock.DXT1, false);
+	BuildAlphaPalette(AlphaPalette, InBlock.Alpha[0], InBlock.Alpha[1]);
+	ExpandColorsScalar(OutBlock, Palette, InBlock.DXT1.Indices);
+	ExpandAlphaScalar(OutBlock, AlphaPalette, GetAlphaIndices(InBlock));
+}
+
+void DXTDecoder::DecodeDXT1(FPlanarBlock& OutBlock, const FDXT1& InBlock)
+{
+	FColorPalette Palette;
+	BuildColorPalette(Palette, InBlock, true);
+	ExpandColors(OutBlock, Palette, InBlock.Indices, true);
+}
+
+void DXTDecoder::DecodeDXT5(FPlanarBlock& OutBlock, const FDXT5& InBlock)
+{
+	FColorPalette Palette;
+	FAlphaPalette AlphaPalette;
+	BuildColorPalette(Palette, InBlock.DXT1, false);
+	BuildAlphaPalette(AlphaPalette, InBlock.Alpha[0], InBlock.Alpha[1]);
+	ExpandColors(OutBlock, Palette, InBlock.DXT1.Indices, false);
+	ExpandAlpha(OutBlock, AlphaPalette, GetAlphaIndices(InBlock));
+}
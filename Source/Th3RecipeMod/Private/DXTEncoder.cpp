@@ -0,0 +1,357 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#include "DXTEncoder.h"
+
+static const int32 MAX_REFINE_ITERATIONS = 2;
+static const int32 POWER_ITERATIONS = 8;
+
+/* Block colors in [0, 255], pixels with zero weight do not count towards the fit */
+struct FColorPoints
+{
+	float R[16];
+	float G[16];
+	float B[16];
+	float Weight[16];
+	bool bTransparent[16];
+};
+
+struct FEncodePalette
+{
+	float R[4];
+	float G[4];
+	float B[4];
+	int32 NumColors;
+};
+
+static FORCEINLINE uint16 Quantize(const float Value, const int32 MaxValue)
+{
+	return static_cast<uint16>(FMath::Clamp(FMath::RoundToInt(Value * MaxValue / 255.0f), 0, MaxValue));
+}
+
+static FORCEINLINE FDXTColor16 PackColor(const float Color[3])
+{
+	FDXTColor16 Packed;
+	Packed.Value = 0;
+	Packed.Color565.R = Quantize(Color[0], 31);
+	Packed.Color565.G = Quantize(Color[1], 63);
+	Packed.Color565.B = Quantize(Color[2], 31);
+	return Packed;
+}
+
+/* What the GPU does, which replicates the high bits into the low ones */
+static FORCEINLINE void ExpandColor(const FDXTColor16 Color, float& R, float& G, float& B)
+{
+	R = static_cast<float>((Color.Color565.R << 3) | (Color.Color565.R >> 2));
+	G = static_cast<float>((Color.Color565.G << 2) | (Color.Color565.G >> 4));
+	B = static_cast<float>((Color.Color565.B << 3) | (Color.Color565.B >> 2));
+}
+
+static void BuildPalette(FEncodePalette& OutPalette, const FDXTColor16 Color0, const FDXTColor16 Color1, const bool bFourColors)
+{
+	ExpandColor(Color0, OutPalette.R[0], OutPalette.G[0], OutPalette.B[0]);
+	ExpandColor(Color1, OutPalette.R[1], OutPalette.G[1], OutPalette.B[1]);
+	if (bFourColors) {
+		OutPalette.R[2] = (2 * OutPalette.R[0] + OutPalette.R[1]) / 3;
+		OutPalette.G[2] = (2 * OutPalette.G[0] + OutPalette.G[1]) / 3;
+		OutPalette.B[2] = (2 * OutPalette.B[0] + OutPalette.B[1]) / 3;
+		OutPalette.R[3] = (OutPalette.R[0] + 2 * OutPalette.R[1]) / 3;
+		OutPalette.G[3] = (OutPalette.G[0] + 2 * OutPalette.G[1]) / 3;
+		OutPalette.B[3] = (OutPalette.B[0] + 2 * OutPalette.B[1]) / 3;
+		OutPalette.NumColors = 4;
+	} else {
+		OutPalette.R[2] = (OutPalette.R[0] + OutPalette.R[1]) / 2;
+		OutPalette.G[2] = (OutPalette.G[0] + OutPalette.G[1]) / 2;
+		OutPalette.B[2] = (OutPalette.B[0] + OutPalette.B[1]) / 2;
+		OutPalette.NumColors = 3;
+	}
+}
+
+/* Nearest palette entry for every pixel, returns the weighted squared error */
+static float SelectIndices(uint32& OutIndices, const FColorPoints& Points, const FEncodePalette& Palette)
+{
+	uint32 Indices = 0;
+	float Error = 0;
+	for (int32 i = 0; i < 16; i++) {
+		uint32 Best = 3;
+		if (not Points.bTransparent[i]) {
+			float BestDist = TNumericLimits<float>::Max();
+			for (int32 Code = 0; Code < Palette.NumColors; Code++) {
+				const float DR = Points.R[i] - Palette.R[Code];
+				const float DG = Points.G[i] - Palette.G[Code];
+				const float DB = Points.B[i] - Palette.B[Code];
+				const float Dist = DR * DR + DG * DG + DB * DB;
+				if (Dist < BestDist) {
+					BestDist = Dist;
+					Best = Code;
+				}
+			}
+			Error += Points.Weight[i] * BestDist;
+		}
+		Indices |= Best << (2 * i);
+	}
+	OutIndices = Indices;
+	return Error;
+}
+
+/* Extremes of the colors along their principal axis */
+static void FitEndpoints(float Start[3], float End[3], const FColorPoints& Points)
+{
+	float Total = 0;
+	float Centroid[3] = { 0, 0, 0 };
+	for (int32 i = 0; i < 16; i++) {
+		Total += Points.Weight[i];
+		Centroid[0] += Points.Weight[i] * Points.R[i];
+		Centroid[1] += Points.Weight[i] * Points.G[i];
+		Centroid[2] += Points.Weight[i] * Points.B[i];
+	}
+	for (int32 c = 0; c < 3; c++) {
+		Centroid[c] /= Total;
+	}
+
+	float Cov[3][3] = {};
+	for (int32 i = 0; i < 16; i++) {
+		const float D[3] = { Points.R[i] - Centroid[0], Points.G[i] - Centroid[1], Points.B[i] - Centroid[2] };
+		for (int32 j = 0; j < 3; j++) {
+			for (int32 k = 0; k < 3; k++) {
+				Cov[j][k] += Points.Weight[i] * D[j] * D[k];
+			}
+		}
+	}
+
+	/* Power iteration, starting from the row of the dominant channel */
+	int32 Dominant = 0;
+	for (int32 c = 1; c < 3; c++) {
+		if (Cov[c][c] > Cov[Dominant][Dominant]) {
+			Dominant = c;
+		}
+	}
+	float Axis[3] = { Cov[Dominant][0], Cov[Dominant][1], Cov[Dominant][2] };
+	for (int32 Iter = 0; Iter < POWER_ITERATIONS; Iter++) {
+		float Next[3];
+		for (int32 j = 0; j < 3; j++) {
+			Next[j] = Cov[j][0] * Axis[0] + Cov[j][1] * Axis[1] + Cov[j][2] * Axis[2];
+		}
+		const float Norm = FMath::Max3(FMath::Abs(Next[0]), FMath::Abs(Next[1]), FMath::Abs(Next[2]));
+		if (Norm < UE_SMALL_NUMBER) {
+			break;
+		}
+		for (int32 j = 0; j < 3; j++) {
+			Axis[j] = Next[j] / Norm;
+		}
+	}
+	const float LengthSq = Axis[0] * Axis[0] + Axis[1] * Axis[1] + Axis[2] * Axis[2];
+	const float InvLength = LengthSq > UE_SMALL_NUMBER ? FMath::InvSqrt(LengthSq) : 0.0f;
+	for (int32 c = 0; c < 3; c++) {
+		Axis[c] *= InvLength;
+	}
+
+	float MinProj = TNumericLimits<float>::Max();
+	float MaxProj = TNumericLimits<float>::Lowest();
+	for (int32 i = 0; i < 16; i++) {
+		if (Points.Weight[i] <= 0) {
+			continue;
+		}
+		const float Proj = (Points.R[i] - Centroid[0]) * Axis[0] + (Points.G[i] - Centroid[1]) * Axis[1] + (Points.B[i] - Centroid[2]) * Axis[2];
+		MinProj = FMath::Min(MinProj, Proj);
+		MaxProj = FMath::Max(MaxProj, Proj);
+	}
+	for (int32 c = 0; c < 3; c++) {
+		Start[c] = FMath::Clamp(Centroid[c] + Axis[c] * MaxProj, 0.0f, 255.0f);
+		End[c] = FMath::Clamp(Centroid[c] + Axis[c] * MinProj, 0.0f, 255.0f);
+	}
+}
+
+/* Least squares endpoints for the given indices, false if they are degenerate */
+static bool SolveEndpoints(float Start[3], float End[3], const FColorPoints& Points, const uint32 Indices, const bool bFourColors)
+{
+	static const float FOUR_COLOR_WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+	static const float THREE_COLOR_WEIGHTS[4] = { 1.0f, 0.0f, 0.5f, 0.0f };
+	const float* Weights = bFourColors ? FOUR_COLOR_WEIGHTS : THREE_COLOR_WEIGHTS;
+
+	float AA = 0, AB = 0, BB = 0;
+	float AX[3] = { 0, 0, 0 };
+	float BX[3] = { 0, 0, 0 };
+	for (int32 i = 0; i < 16; i++) {
+		if (Points.bTransparent[i]) {
+			continue;
+		}
+		const float W = Points.Weight[i];
+		const float A = Weights[(Indices >> (2 * i)) & 0x03];
+		const float B = 1.0f - A;
+		const float X[3] = { Points.R[i], Points.G[i], Points.B[i] };
+		AA += W * A * A;
+		AB += W * A * B;
+		BB += W * B * B;
+		for (int32 c = 0; c < 3; c++) {
+			AX[c] += W * A * X[c];
+			BX[c] += W * B * X[c];
+		}
+	}
+	const float Det = AA * BB - AB * AB;
+	if (FMath::Abs(Det) < UE_KINDA_SMALL_NUMBER) {
+		return false;
+	}
+	const float InvDet = 1.0f / Det;
+	for (int32 c = 0; c < 3; c++) {
+		Start[c] = FMath::Clamp((AX[c] * BB - BX[c] * AB) * InvDet, 0.0f, 255.0f);
+		End[c] = FMath::Clamp((BX[c] * AA - AX[c] * AB) * InvDet, 0.0f, 255.0f);
+	}
+	return true;
+}
+
+/* Orders the endpoints for the wanted palette mode, then picks the indices */
+static float TryEndpoints(FDXT1& OutBlock, const FColorPoints& Points, const float Start[3], const float End[3], const bool bFourColors)
+{
+	FDXTColor16 Color0 = PackColor(Start);
+	FDXTColor16 Color1 = PackColor(End);
+	if (bFourColors ? Color0.Value < Color1.Value : Color0.Value > Color1.Value) {
+		Swap(Color0, Color1);
+	}
+	OutBlock.Color[0] = Color0;
+	OutBlock.Color[1] = Color1;
+
+	/* Equal endpoints always select the first code, which is the same color in both modes */
+	FEncodePalette Palette;
+	BuildPalette(Palette, Color0, Color1, bFourColors);
+	return SelectIndices(OutBlock.Indices, Points, Palette);
+}
+
+static void EncodeColors(FDXT1& OutBlock, const FColorPoints& Points, const bool bFourColors, const DXTEncoder::FEncodeOptions& Options)
+{
+	float Start[3], End[3];
+	FitEndpoints(Start, End, Points);
+	float Error = TryEndpoints(OutBlock, Points, Start, End, bFourColors);
+	if (not Options.bRefine) {
+		return;
+	}
+	for (int32 Iter = 0; Iter < MAX_REFINE_ITERATIONS and Error > 0; Iter++) {
+		if (not SolveEndpoints(Start, End, Points, OutBlock.Indices, bFourColors)) {
+			break;
+		}
+		FDXT1 Candidate;
+		const float NewError = TryEndpoints(Candidate, Points, Start, End, bFourColors);
+		if (NewError >= Error) {
+			break;
+		}
+		OutBlock = Candidate;
+		Error = NewError;
+	}
+}
+
+static FORCEINLINE void LoadColors(FColorPoints& OutPoints, const FPlanarBlock& InBlock)
+{
+	for (int32 i = 0; i < 16; i++) {
+		OutPoints.R[i] = FMath::Clamp(InBlock.R[i], 0.0f, 1.0f) * 255.0f;
+		OutPoints.G[i] = FMath::Clamp(InBlock.G[i], 0.0f, 1.0f) * 255.0f;
+		OutPoints.B[i] = FMath::Clamp(InBlock.B[i], 0.0f, 1.0f) * 255.0f;
+		OutPoints.Weight[i] = 1.0f;
+		OutPoints.bTransparent[i] = false;
+	}
+}
+
+void DXTEncoder::EncodeDXT1(FDXT1& OutBlock, const FPlanarBlock& InBlock, const FEncodeOptions& Options)
+{
+	FColorPoints Points;
+	LoadColors(Points, InBlock);
+
+	int32 NumTransparent = 0;
+	for (int32 i = 0; i < 16; i++) {
+		if (InBlock.A[i] < DXT1_ALPHA_THRESHOLD) {
+			Points.Weight[i] = 0.0f;
+			Points.bTransparent[i] = true;
+			NumTransparent++;
+		}
+	}
+	if (NumTransparent == 16) {
+		OutBlock.Color[0].Value = 0;
+		OutBlock.Color[1].Value = 0;
+		OutBlock.Indices = 0xffffffff;
+		return;
+	}
+	/* Punch-through alpha needs the three color mode */
+	EncodeColors(OutBlock, Points, NumTransparent == 0, Options);
+}
+
+static float SelectAlphaIndices(uint64& OutBits, const float Alpha[16], const uint8 Alpha0, const uint8 Alpha1)
+{
+	DXTDecoder::FAlphaPalette Palette;
+	DXTDecoder::BuildAlphaPalette(Palette, Alpha0, Alpha1);
+	uint64 Bits = 0;
+	float Error = 0;
+	for (int32 i = 0; i < 16; i++) {
+		uint64 Best = 0;
+		float BestDist = TNumericLimits<float>::Max();
+		for (int32 Code = 0; Code < 8; Code++) {
+			const float Dist = FMath::Square(Alpha[i] - Palette.A[Code]);
+			if (Dist < BestDist) {
+				BestDist = Dist;
+				Best = Code;
+			}
+		}
+		Error += BestDist;
+		Bits |= Best << (3 * i);
+	}
+	OutBits = Bits;
+	return Error;
+}
+
+static void EncodeAlpha(FDXT5& OutBlock, const FPlanarBlock& InBlock, const DXTEncoder::FEncodeOptions& Options)
+{
+	float Alpha[16];
+	uint8 Min = 0xff, Max = 0x00;
+	uint8 MinInner = 0xff, MaxInner = 0x00;
+	for (int32 i = 0; i < 16; i++) {
+		Alpha[i] = FMath::Clamp(InBlock.A[i], 0.0f, 1.0f);
+		const uint8 Value = static_cast<uint8>(FMath::RoundToInt(Alpha[i] * 255.0f));
+		Min = FMath::Min(Min, Value);
+		Max = FMath::Max(Max, Value);
+		if (Value != 0x00 and Value != 0xff) {
+			MinInner = FMath::Min(MinInner, Value);
+			MaxInner = FMath::Max(MaxInner, Value);
+		}
+	}
+
+	/* Eight interpolated values spanning the whole range */
+	uint8 Alpha0 = Max, Alpha1 = Min;
+	uint64 Bits;
+	const float Error = SelectAlphaIndices(Bits, Alpha, Alpha0, Alpha1);
+
+	/* Six values spanning the inner range, with exact 0 and 255 on the side */
+	if (Options.bRefine and Error > 0 and MinInner <= MaxInner and (Min == 0x00 or Max == 0xff)) {
+		uint64 InnerBits;
+		if (SelectAlphaIndices(InnerBits, Alpha, MinInner, MaxInner) < Error) {
+			Alpha0 = MinInner;
+			Alpha1 = MaxInner;
+			Bits = InnerBits;
+		}
+	}
+
+	OutBlock.Alpha[0] = Alpha0;
+	OutBlock.Alpha[1] = Alpha1;
+	for (int32 i = 0; i < 6; i++) {
+		OutBlock.Alpha[2 + i] = static_cast<uint8>(Bits >> (8 * i));
+	}
+}
+
+void DXTEncoder::EncodeDXT5(FDXT5& OutBlock, const FPlanarBlock& InBlock, const FEncodeOptions& Options)
+{
+	EncodeAlpha(OutBlock, InBlock, Options);
+
+	/* Fully transparent pixels can have any color, leave them out unless all of them are */
+	FColorPoints Points;
+	LoadColors(Points, InBlock);
+	int32 NumVisible = 0;
+	for (int32 i = 0; i < 16; i++) {
+		if (InBlock.A[i] < 0.5f / 255) {
+			Points.Weight[i] = 0.0f;
+		} else {
+			NumVisible++;
+		}
+	}
+	if (NumVisible == 0) {
+		for (int32 i = 0; i < 16; i++) {
+			Points.Weight[i] = 1.0f;
+		}
+	}
+	EncodeColors(OutBlock.DXT1, Points, true, Options);
+}
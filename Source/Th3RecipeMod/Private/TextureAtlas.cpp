@@ -0,0 +1,195 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#include "TextureAtlas.h"
+
+#include <Engine/Texture2D.h>
+
+DEFINE_LOG_CATEGORY(LogTh3TextureAtlas);
+
+/* Padding on each side of a slot, as a fraction of its size */
+static constexpr int32 GUTTER_FRACTION = 16;
+
+FSlateBrush FAtlasSlot::MakeBrush() const
+{
+	FSlateBrush Brush;
+	Brush.SetResourceObject(Page.Get());
+	Brush.ImageSize = FVector2D(Size, Size);
+	Brush.SetUVRegion(UV);
+	return Brush;
+}
+
+/* Smallest mip that still lines up with the grid, icons stop at 4x4 anyway */
+static int32 GetMinSize(const EPixelFormat Format)
+{
+	return FMath::Max(GPixelFormats[Format].BlockSizeX, 4);
+}
+
+/* In texels of the first mip, a power of two and at least one block */
+int32 FTextureAtlas::GetGutter(const EPixelFormat Format, const int32 SlotSize) const
+{
+	return FMath::Max(SlotSize / GUTTER_FRACTION, GetMinSize(Format));
+}
+
+/* Only mips where the gutter is still at least one block, below that neighbours would bleed in */
+int32 FTextureAtlas::GetNumMips(const EPixelFormat Format, const int32 SlotSize) const
+{
+	const int32 MinSize = GetMinSize(Format);
+	const int32 Gutter = GetGutter(Format, SlotSize);
+	int32 NumMips = 0;
+	while ((SlotSize >> NumMips) >= MinSize and (Gutter >> NumMips) >= MinSize) {
+		NumMips++;
+	}
+	return NumMips;
+}
+
+int32 FTextureAtlas::GetSlotsPerRow(const EPixelFormat Format, const int32 SlotSize) const
+{
+	return PageSize / (SlotSize + 2 * GetGutter(Format, SlotSize));
+}
+
+FTextureAtlas::FPage* FTextureAtlas::FindPage(const EPixelFormat Format, const int32 SlotSize)
+{
+	const int32 NumSlots = FMath::Square(GetSlotsPerRow(Format, SlotSize));
+	return Pages.FindByPredicate([Format, SlotSize, NumSlots](const FPage& Page) {
+		return Page.Format == Format and Page.SlotSize == SlotSize and Page.NumUsed < NumSlots;
+	});
+}
+
+FTextureAtlas::FPage& FTextureAtlas::AddPage(const EPixelFormat Format, const int32 SlotSize)
+{
+	const FString Name = FString::Printf(TEXT("Th3Atlas_%s_%d_%d"), GetPixelFormatString(Format), SlotSize, Pages.Num());
+	UTexture2D* Texture = UTexture2D::CreateTransient(PageSize, PageSize, Format, FName(Name));
+	const FPixelFormatInfo& FmtInfo = GPixelFormats[Format];
+	for (int32 MipIdx = 1; MipIdx < GetNumMips(Format, SlotSize); MipIdx++) {
+		FTexture2DMipMap* Mip = new FTexture2DMipMap();
+		Texture->GetPlatformData()->Mips.Add(Mip);
+		Mip->SizeX = PageSize >> MipIdx;
+		Mip->SizeY = PageSize >> MipIdx;
+		Mip->SizeZ = 1;
+		const size_t NumBytes = static_cast<size_t>(Mip->SizeX / FmtInfo.BlockSizeX) * (Mip->SizeY / FmtInfo.BlockSizeY) * FmtInfo.BlockBytes;
+		Mip->BulkData.Lock(LOCK_READ_WRITE);
+		Mip->BulkData.Realloc(NumBytes);
+		Mip->BulkData.Unlock();
+	}
+	/* Slots are filled in one at a time, the rest of the page stays transparent */
+	for (FTexture2DMipMap& Mip : Texture->GetPlatformData()->Mips) {
+		FMemory::Memzero(Mip.BulkData.Lock(LOCK_READ_WRITE), Mip.BulkData.GetBulkDataSize());
+		Mip.BulkData.Unlock();
+	}
+	UE_LOG(LogTh3TextureAtlas, Log, TEXT("New %dx%d %s page for %dx%d textures"), PageSize, PageSize, GetPixelFormatString(Format), SlotSize, SlotSize);
+	return Pages.Add_GetRef({ .Texture = Texture, .Format = Format, .SlotSize = SlotSize });
+}
+
+FAtlasSlot FTextureAtlas::Add(const UTexture2D* Texture)
+{
+	fgcheck(IsInGameThread());
+	if (const FAtlasSlot* Existing = Slots.Find(Texture)) {
+		return *Existing;
+	}
+	const FTexturePlatformData* PlatformData = Texture->GetPlatformData();
+	const EPixelFormat Format = PlatformData->PixelFormat;
+	const int32 SlotSize = Texture->GetSizeX();
+	if (SlotSize != Texture->GetSizeY() or not FMath::IsPowerOfTwo(SlotSize) or GetSlotsPerRow(Format, SlotSize) == 0) {
+		UE_LOG(LogTh3TextureAtlas, Warning, TEXT("%s is %dx%d, it does not fit in a %d page"), *Texture->GetName(), Texture->GetSizeX(), Texture->GetSizeY(), PageSize);
+		return FAtlasSlot();
+	}
+	const int32 NumMips = GetNumMips(Format, SlotSize);
+	if (NumMips == 0 or PlatformData->Mips.Num() < NumMips) {
+		UE_LOG(LogTh3TextureAtlas, Warning, TEXT("%s has %d mips, %d needed"), *Texture->GetName(), PlatformData->Mips.Num(), NumMips);
+		return FAtlasSlot();
+	}
+
+	FPage* Found = FindPage(Format, SlotSize);
+	FPage& Page = Found ? *Found : AddPage(Format, SlotSize);
+	const int32 SlotsPerRow = GetSlotsPerRow(Format, SlotSize);
+	const int32 SlotX = Page.NumUsed % SlotsPerRow;
+	const int32 SlotY = Page.NumUsed / SlotsPerRow;
+	const int32 Gutter = GetGutter(Format, SlotSize);
+	const int32 CellSize = SlotSize + 2 * Gutter;
+
+	/* Same grid on every mip, the gutter keeps every cell aligned to whole blocks */
+	const FPixelFormatInfo& FmtInfo = GPixelFormats[Format];
+	for (int32 MipIdx = 0; MipIdx < NumMips; MipIdx++) {
+		FByteBulkData& SrcData = const_cast<FByteBulkData&>(PlatformData->Mips[MipIdx].BulkData);
+		FByteBulkData& DstData = Page.Texture->GetPlatformData()->Mips[MipIdx].BulkData;
+		const int32 BlocksX = (SlotSize >> MipIdx) / FmtInfo.BlockSizeX;
+		const int32 BlocksY = (SlotSize >> MipIdx) / FmtInfo.BlockSizeY;
+		const int32 GutterX = (Gutter >> MipIdx) / FmtInfo.BlockSizeX;
+		const int32 GutterY = (Gutter >> MipIdx) / FmtInfo.BlockSizeY;
+		const int32 PageBlocksX = (PageSize >> MipIdx) / FmtInfo.BlockSizeX;
+		const size_t BlockBytes = FmtInfo.BlockBytes;
+		const size_t RowBytes = BlocksX * BlockBytes;
+		const size_t PageRowBytes = PageBlocksX * BlockBytes;
+
+		const uint8* Src = static_cast<const uint8*>(SrcData.LockReadOnly());
+		uint8* Dst = static_cast<uint8*>(DstData.Lock(LOCK_READ_WRITE));
+		if (Src and SrcData.GetBulkDataSize() >= static_cast<int64>(RowBytes * BlocksY)) {
+			/* Top left of the cell, the slot itself starts a gutter further in */
+			const int32 CellBlocksX = (CellSize >> MipIdx) / FmtInfo.BlockSizeX;
+			const int32 CellBlocksY = (CellSize >> MipIdx) / FmtInfo.BlockSizeY;
+			Dst += static_cast<size_t>(SlotY * CellBlocksY) * PageRowBytes + SlotX * CellBlocksX * BlockBytes;
+			/* Gutter rows and columns repeat the nearest edge block */
+			for (int32 Y = 0; Y < CellBlocksY; Y++) {
+				const uint8* SrcRow = Src + FMath::Clamp(Y - GutterY, 0, BlocksY - 1) * RowBytes;
+				uint8* DstRow = Dst + Y * PageRowBytes;
+				for (int32 X = 0; X < GutterX; X++) {
+					FMemory::Memcpy(DstRow + X * BlockBytes, SrcRow, BlockBytes);
+					FMemory::Memcpy(DstRow + (GutterX + BlocksX + X) * BlockBytes, SrcRow + RowBytes - BlockBytes, BlockBytes);
+				}
+				FMemory::Memcpy(DstRow + GutterX * BlockBytes, SrcRow, RowBytes);
+			}
+		} else {
+			UE_LOG(LogTh3TextureAtlas, Warning, TEXT("%s has no CPU copy of mip %d, its slot stays empty"), *Texture->GetName(), MipIdx);
+		}
+		DstData.Unlock();
+		SrcData.Unlock();
+	}
+	Page.NumUsed++;
+	Page.bDirty = true;
+
+	const FVector2f Min = FVector2f(SlotX * CellSize + Gutter, SlotY * CellSize + Gutter) / PageSize;
+	const FAtlasSlot Slot = {
+		.Page = Page.Texture.Get(),
+		.UV = FBox2f(Min, Min + FVector2f(SlotSize, SlotSize) / PageSize),
+		.Size = SlotSize,
+	};
+	Slots.Add(Texture, Slot);
+	return Slot;
+}
+
+FAtlasSlot FTextureAtlas::Find(const UTexture2D* Texture) const
+{
+	const FAtlasSlot* Slot = Slots.Find(Texture);
+	return Slot ? *Slot : FAtlasSlot();
+}
+
+void FTextureAtlas::Flush(const double MinIntervalSeconds)
+{
+	fgcheck(IsInGameThread());
+	const double Now = FPlatformTime::Seconds();
+	for (FPage& Page : Pages) {
+		if (not Page.bDirty) {
+			continue;
+		}
+		/* Nothing is ever added to a full page again */
+		const bool bFull = Page.NumUsed == FMath::Square(GetSlotsPerRow(Page.Format, Page.SlotSize));
+		if (not bFull and Now - Page.LastFlush < MinIntervalSeconds) {
+			continue;
+		}
+		if (bFull) {
+			for (FTexture2DMipMap& Mip : Page.Texture->GetPlatformData()->Mips) {
+				Mip.BulkData.SetBulkDataFlags(BULKDATA_SingleUse);
+			}
+		}
+		Page.Texture->UpdateResource();
+		Page.bDirty = false;
+		Page.LastFlush = Now;
+	}
+}
+
+void FTextureAtlas::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	for (FPage& Page : Pages) {
+		Collector.AddReferencedObject(Page.Texture);
+	}
+}
@@ -0,0 +1,141 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#include "TextureCache.h"
+
+#include <HAL/PlatformFileManager.h>
+#include <Async/MappedFileHandle.h>
+#include <Misc/Paths.h>
+
+DEFINE_LOG_CATEGORY(LogTh3TextureCache);
+
+/* "T3TC", bump the version whenever the file layout changes */
+static const uint32 CACHE_MAGIC = 0x43543354;
+static const uint32 CACHE_VERSION = 1;
+
+struct FCacheHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	uint32 Format;
+	uint32 NumMips;
+};
+
+struct FCacheMip
+{
+	uint64 Offset;
+	uint64 NumBytes;
+};
+
+static FString GetEntryPath(const TextureCache::FKey& Key)
+{
+	return TextureCache::GetCacheDir() / Key.ToString() + TEXT(".th3tc");
+}
+
+FString TextureCache::GetCacheDir()
+{
+	return FPaths::ProjectSavedDir() / TEXT("Th3RecipeMod") / TEXT("TextureCache");
+}
+
+bool TextureCache::Load(const FKey& Key, const EPixelFormat Format, TArrayView<const TArrayView<uint8>> OutMips)
+{
+	const FString Path = GetEntryPath(Key);
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if (not PlatformFile.FileExists(*Path)) {
+		return false;
+	}
+	const TUniquePtr<IMappedFileHandle> Handle(PlatformFile.OpenMapped(*Path));
+	if (not Handle) {
+		UE_LOG(LogTh3TextureCache, Warning, TEXT("Could not map %s"), *Path);
+		return false;
+	}
+	const uint64 FileSize = Handle->GetFileSize();
+	const TUniquePtr<IMappedFileRegion> Region(Handle->MapRegion(0, FileSize));
+	if (not Region) {
+		UE_LOG(LogTh3TextureCache, Warning, TEXT("Could not map %s"), *Path);
+		return false;
+	}
+	const uint8* Bytes = Region->GetMappedPtr();
+
+	const uint64 TableEnd = sizeof(FCacheHeader) + OutMips.Num() * sizeof(FCacheMip);
+	if (FileSize < TableEnd) {
+		UE_LOG(LogTh3TextureCache, Warning, TEXT("%s is truncated"), *Path);
+		return false;
+	}
+	FCacheHeader Header;
+	FMemory::Memcpy(&Header, Bytes, sizeof(Header));
+	if (Header.Magic != CACHE_MAGIC or Header.Version != CACHE_VERSION) {
+		UE_LOG(LogTh3TextureCache, Log, TEXT("%s is from another version"), *Path);
+		return false;
+	}
+	if (Header.Format != Format or Header.NumMips != static_cast<uint32>(OutMips.Num())) {
+		UE_LOG(LogTh3TextureCache, Warning, TEXT("%s has %u mips of %s, expected %d mips of %s"), *Path, Header.NumMips, GetPixelFormatString(static_cast<EPixelFormat>(Header.Format)), OutMips.Num(), GetPixelFormatString(Format));
+		return false;
+	}
+
+	/* Check everything before touching the output */
+	TArray<FCacheMip> Mips;
+	Mips.SetNumUninitialized(OutMips.Num());
+	FMemory::Memcpy(Mips.GetData(), Bytes + sizeof(FCacheHeader), OutMips.Num() * sizeof(FCacheMip));
+	for (int32 i = 0; i < OutMips.Num(); i++) {
+		if (Mips[i].NumBytes != static_cast<uint64>(OutMips[i].Num()) or Mips[i].Offset > FileSize or Mips[i].NumBytes > FileSize - Mips[i].Offset) {
+			UE_LOG(LogTh3TextureCache, Warning, TEXT("%s has a bad layout for mip %d"), *Path, i);
+			return false;
+		}
+	}
+	for (int32 i = 0; i < OutMips.Num(); i++) {
+		FMemory::Memcpy(OutMips[i].GetData(), Bytes + Mips[i].Offset, Mips[i].NumBytes);
+	}
+	return true;
+}
+
+bool TextureCache::Store(const FKey& Key, const EPixelFormat Format, TArrayView<const TConstArrayView<uint8>> InMips)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if (not PlatformFile.CreateDirectoryTree(*GetCacheDir())) {
+		UE_LOG(LogTh3TextureCache, Warning, TEXT("Could not create %s"), *GetCacheDir());
+		return false;
+	}
+
+	const FCacheHeader Header = {
+		.Magic = CACHE_MAGIC,
+		.Version = CACHE_VERSION,
+		.Format = static_cast<uint32>(Format),
+		.NumMips = static_cast<uint32>(InMips.Num()),
+	};
+	TArray<FCacheMip> Mips;
+	uint64 Offset = sizeof(FCacheHeader) + InMips.Num() * sizeof(FCacheMip);
+	for (const TConstArrayView<uint8>& Mip : InMips) {
+		Mips.Add({ .Offset = Offset, .NumBytes = static_cast<uint64>(Mip.Num()) });
+		Offset += Mip.Num();
+	}
+
+	/* Write under a temporary name, so that a crash or another instance never sees half an entry */
+	const FString Path = GetEntryPath(Key);
+	const FString TempPath = Path + FString::Printf(TEXT(".%u.tmp"), FPlatformTLS::GetCurrentThreadId());
+	bool bSuccess = false;
+	{
+		const TUniquePtr<IFileHandle> File(PlatformFile.OpenWrite(*TempPath));
+		if (not File) {
+			UE_LOG(LogTh3TextureCache, Warning, TEXT("Could not open %s for writing"), *TempPath);
+			return false;
+		}
+		bSuccess = File->Write(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+		bSuccess = bSuccess and File->Write(reinterpret_cast<const uint8*>(Mips.GetData()), Mips.Num() * sizeof(FCacheMip));
+		for (const TConstArrayView<uint8>& Mip : InMips) {
+			bSuccess = bSuccess and File->Write(Mip.GetData(), Mip.Num());
+		}
+		bSuccess = bSuccess and File->Flush();
+	}
+	if (not bSuccess) {
+		UE_LOG(LogTh3TextureCache, Warning, TEXT("Could not write %s"), *TempPath);
+		PlatformFile.DeleteFile(*TempPath);
+		return false;
+	}
+	PlatformFile.DeleteFile(*Path);
+	if (not PlatformFile.MoveFile(*Path, *TempPath)) {
+		UE_LOG(LogTh3TextureCache, Warning, TEXT("Could not move %s to %s"), *TempPath, *Path);
+		PlatformFile.DeleteFile(*TempPath);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,91 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#include "TextureResidency.h"
+
+DEFINE_LOG_CATEGORY(LogTh3TextureResidency);
+
+/* Shared by every residency, a texture stays forced until the last one lets go of it */
+struct FPin
+{
+	int32 Count = 0;
+	bool bForced = false;
+};
+static TMap<TObjectKey<UTexture2D>, FPin> Pins;
+
+static bool IsMipResident(const UTexture2D* Texture, const int32 MipIdx)
+{
+	if (not Texture->IsStreamable()) {
+		return true;
+	}
+	return not Texture->HasPendingInitOrStreaming() and Texture->GetNumResidentMips() >= Texture->GetNumMips() - MipIdx;
+}
+
+void FTextureResidency::Add(UTexture2D* Texture, const int32 FirstMipIdx)
+{
+	fgcheck(IsInGameThread());
+	fgcheck(Texture);
+	FEntry* Entry = Textures.FindByPredicate([Texture](const FEntry& Other) {
+		return Other.Texture == Texture;
+	});
+	if (Entry) {
+		Entry->FirstMipIdx = FMath::Min(Entry->FirstMipIdx, FirstMipIdx);
+	} else {
+		Textures.Add({ Texture, Texture, FirstMipIdx });
+		Pins.FindOrAdd(Texture).Count++;
+	}
+
+	/* Also when resident already, the mips may be read frames later (see FOverlayQueue) */
+	FPin& Pin = Pins.FindChecked(Texture);
+	if (not Pin.bForced) {
+		UE_LOG(LogTh3TextureResidency, Verbose, TEXT("Keeping %s resident from mip %d"), *Texture->GetName(), FirstMipIdx);
+		Texture->SetForceMipLevelsToBeResident(3600, 0);
+		Pin.bForced = true;
+	}
+}
+
+bool FTextureResidency::IsReady() const
+{
+	for (const FEntry& Entry : Textures) {
+		const UTexture2D* Texture = Entry.Texture.Get();
+		if (Texture and not IsMipResident(Texture, Entry.FirstMipIdx)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void FTextureResidency::Wait()
+{
+	fgcheck(IsInGameThread());
+	/* Everything was requested already, so only the slowest texture is really waited for */
+	for (const FEntry& Entry : Textures) {
+		UTexture2D* Texture = Entry.Texture.Get();
+		if (Texture and not IsMipResident(Texture, Entry.FirstMipIdx)) {
+			Texture->WaitForStreaming(true, false);
+		}
+	}
+}
+
+void FTextureResidency::Release()
+{
+	fgcheck(IsInGameThread());
+	for (const FEntry& Entry : Textures) {
+		FPin* Pin = Pins.Find(Entry.Key);
+		if (not Pin or --Pin->Count > 0) {
+			continue;
+		}
+		UTexture2D* Texture = Entry.Texture.Get();
+		if (Pin->bForced and Texture) {
+			Texture->SetForceMipLevelsToBeResident(0, 0);
+		}
+		Pins.Remove(Entry.Key);
+	}
+	Textures.Empty();
+}
+
+bool FTextureResidency::IsPinned(const UTexture2D* Texture)
+{
+	fgcheck(IsInGameThread());
+	const FPin* Pin = Pins.Find(Texture);
+	return Pin and Pin->bForced;
+}
@@ -0,0 +1,198 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#include "Th3Tex2DUtils.h"
+#include "BlockMapper.h"
+#include "BlendKernels.h"
+#include "PlanarMip.h"
+#include "PreciseColor.h"
+
+#include <HAL/IConsoleManager.h>
+#include <Async/TaskGraphInterfaces.h>
+#include <Math/RandomStream.h>
+#include <Math/Float16Color.h>
+
+DEFINE_LOG_CATEGORY_STATIC(LogTh3Benchmark, Log, All);
+
+/*
+ * Th3.Benchmark [Size ...] [Iterations=N]
+ *
+ * Times every stage of the icon pipeline on synthetic mips: decode and
+ * encode through BlockMapper, the "over" kernel and the whole overlay for
+ * each pair of source and output formats. Decode, blend and encode run
+ * on one thread, the overlay spreads its block rows over the task graph.
+ * "Erased" and "Planar" compare one DXT5 over DXT5 mip done block by block
+ * through a type-erased blend, the way the overlay used to work, against
+ * whole planar mips and the inlined kernel.
+ */
+
+static const EPixelFormat SOURCE_FORMATS[] = {
+	EPixelFormat::PF_DXT1,
+	EPixelFormat::PF_DXT5,
+	EPixelFormat::PF_B8G8R8A8,
+	EPixelFormat::PF_FloatRGBA,
+	EPixelFormat::PF_BC7,
+};
+
+static const EPixelFormat OUTPUT_FORMATS[] = {
+	EPixelFormat::PF_DXT1,
+	EPixelFormat::PF_DXT5,
+	EPixelFormat::PF_B8G8R8A8,
+};
+
+/* Random blocks are valid DXT, BC7 and BGRA, half floats are kept within 0..1 */
+static UTexture2D* MakeSyntheticTexture(const EPixelFormat Format, const int32 Size, const int32 Seed)
+{
+	const FString Name = FString::Printf(TEXT("Th3Bench_%s_%d_%d"), GetPixelFormatString(Format), Size, Seed);
+	UTexture2D* Texture = UTexture2D::CreateTransient(Size, Size, Format, FName(Name));
+	FByteBulkData& BulkData = Texture->GetPlatformData()->Mips[0].BulkData;
+	uint8* Bytes = static_cast<uint8*>(BulkData.Lock(LOCK_READ_WRITE));
+	const int64 NumBytes = BulkData.GetBulkDataSize();
+	FRandomStream Random(Seed);
+	if (Format == EPixelFormat::PF_FloatRGBA) {
+		FFloat16Color* Pixels = reinterpret_cast<FFloat16Color*>(Bytes);
+		for (int64 i = 0; i < NumBytes / static_cast<int64>(sizeof(FFloat16Color)); i++) {
+			Pixels[i] = FFloat16Color(FLinearColor(Random.GetFraction(), Random.GetFraction(), Random.GetFraction(), Random.GetFraction()));
+		}
+	} else {
+		for (int64 i = 0; i < NumBytes; i++) {
+			Bytes[i] = static_cast<uint8>(Random.RandHelper(256));
+		}
+	}
+	BulkData.Unlock();
+	return Texture;
+}
+
+/* Best of Iterations, in seconds */
+template<typename FuncT>
+static double TimeBest(const int32 Iterations, FuncT&& Func)
+{
+	double Best = TNumericLimits<double>::Max();
+	for (int32 i = 0; i < Iterations; i++) {
+		const double Begin = FPlatformTime::Seconds();
+		Func(i);
+		Best = FMath::Min(Best, FPlatformTime::Seconds() - Begin);
+	}
+	return Best;
+}
+
+/* Blocks by value through a TFunction, one virtual read or write per block */
+using FErasedBlend = TFunction<FPreciseBlock(FPreciseBlock, FPreciseBlock)>;
+
+static FPreciseBlock OverBlock(FPreciseBlock Bot, FPreciseBlock Top)
+{
+	FPreciseBlock Out;
+	for (int32 i = 0; i < MAX_BLOCK_PIXELS; i++) {
+		Out.Data[i] = FPreciseColor::Over(Bot.Data[i], Top.Data[i]);
+	}
+	return Out;
+}
+
+static void ApplyErased(BlockMapper& Out, const BlockMapper& Bot, const BlockMapper& Top, const FErasedBlend& Blend)
+{
+	for (size_t y = 0; y < Out.GetSizeY(); y += MAX_BLOCK_SIDE) {
+		for (size_t x = 0; x < Out.GetSizeX(); x += MAX_BLOCK_SIDE) {
+			Out.WriteBlock(x, y, Blend(Bot.ReadBlock(x, y), Top.ReadBlock(x, y)));
+		}
+	}
+}
+
+static void Report(const TCHAR* Stage, const TCHAR* Formats, const int32 Size, const int32 NumThreads, const double Seconds)
+{
+	const double NumPixels = static_cast<double>(Size) * Size;
+	const double NumBlocks = NumPixels / 16;
+	UE_LOG(LogTh3Benchmark, Display, TEXT("%-8s %-26s %5d  %2d threads  %9.2f Mpixels/s  %8.1f ns/block"), Stage, Formats, Size, NumThreads, NumPixels / Seconds / 1e6, Seconds * 1e9 / NumBlocks);
+}
+
+static void RunBenchmark(const TArray<FString>& Args)
+{
+	TArray<int32> Sizes;
+	int32 Iterations = 5;
+	for (const FString& Arg : Args) {
+		if (Arg.StartsWith(TEXT("Iterations="))) {
+			Iterations = FMath::Max(FCString::Atoi(*Arg.RightChop(11)), 1);
+		} else if (FMath::IsPowerOfTwo(FCString::Atoi(*Arg)) and FCString::Atoi(*Arg) >= 4) {
+			Sizes.Add(FCString::Atoi(*Arg));
+		} else {
+			UE_LOG(LogTh3Benchmark, Warning, TEXT("Ignoring '%s', sizes are powers of two from 4"), *Arg);
+		}
+	}
+	if (Sizes.IsEmpty()) {
+		Sizes = { 64, 256, 1024, 4096 };
+	}
+	const int32 NumWorkers = FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+
+	for (const int32 Size : Sizes) {
+		TPlanarMip<FFloatPrecision> Bot, Top, Out;
+		for (const EPixelFormat Format : SOURCE_FORMATS) {
+			UTexture2D* Texture = MakeSyntheticTexture(Format, Size, 0);
+			const BlockMapper Mapper(Texture, 0, EMipAccess::ReadOnly);
+			const double Seconds = TimeBest(Iterations, [&](int32) {
+				Mapper.DecodeMip(Bot);
+			});
+			Report(TEXT("Decode"), GetPixelFormatString(Format), Size, 1, Seconds);
+		}
+
+		Top = Bot;
+		const double OverSeconds = TimeBest(Iterations, [&](int32) {
+			BlendKernels::OverStraight(Out, Bot, Top);
+		});
+		Report(TEXT("Over"), TEXT("Float"), Size, 1, OverSeconds);
+
+		{
+			const BlockMapper BotMapper(MakeSyntheticTexture(EPixelFormat::PF_DXT5, Size, 0), 0, EMipAccess::ReadOnly);
+			const BlockMapper TopMapper(MakeSyntheticTexture(EPixelFormat::PF_DXT5, Size, 1), 0, EMipAccess::ReadOnly);
+			BlockMapper OutMapper(UTexture2D::CreateTransient(Size, Size, EPixelFormat::PF_DXT5), 0, EMipAccess::ReadWrite);
+			OutMapper.SetEncodeOptions({ .bRefine = true });
+			const FErasedBlend Blend = &OverBlock;
+			const double ErasedSeconds = TimeBest(Iterations, [&](int32) {
+				ApplyErased(OutMapper, BotMapper, TopMapper, Blend);
+			});
+			Report(TEXT("Erased"), TEXT("DXT5 over DXT5 to DXT5"), Size, 1, ErasedSeconds);
+			TPlanarMip<FFloatPrecision> BotMip, TopMip, OutMip;
+			const double PlanarSeconds = TimeBest(Iterations, [&](int32) {
+				BotMapper.DecodeMip(BotMip);
+				TopMapper.DecodeMip(TopMip);
+				BlendKernels::OverStraight(OutMip, BotMip, TopMip);
+				OutMapper.EncodeMip(OutMip);
+			});
+			Report(TEXT("Planar"), TEXT("DXT5 over DXT5 to DXT5"), Size, 1, PlanarSeconds);
+			UE_LOG(LogTh3Benchmark, Display, TEXT("Planar is %.2fx the speed of erased at %d"), ErasedSeconds / PlanarSeconds, Size);
+		}
+
+		for (const EPixelFormat Format : OUTPUT_FORMATS) {
+			UTexture2D* Texture = UTexture2D::CreateTransient(Size, Size, Format);
+			BlockMapper Mapper(Texture, 0, EMipAccess::ReadWrite);
+			Mapper.SetEncodeOptions({ .bRefine = true });
+			const double Seconds = TimeBest(Iterations, [&](int32) {
+				Mapper.EncodeMip(Out);
+			});
+			Report(TEXT("Encode"), GetPixelFormatString(Format), Size, 1, Seconds);
+		}
+
+		/* Fresh sources every time, the same ones would only share the first result */
+		UTexture2D* Overlay = MakeSyntheticTexture(EPixelFormat::PF_DXT5, Size, 1);
+		for (const EPixelFormat BotFormat : SOURCE_FORMATS) {
+			for (const EPixelFormat OutFormat : OUTPUT_FORMATS) {
+				Th3Tex2DUtils::FOverlayOptions Options;
+				Options.OutputFormat = OutFormat;
+				Options.bUseCache = false;
+				TArray<UTexture2D*> Sources;
+				for (int32 i = 0; i < Iterations; i++) {
+					Sources.Add(MakeSyntheticTexture(BotFormat, Size, 2 + i));
+				}
+				const double Seconds = TimeBest(Iterations, [&](int32 i) {
+					Th3Tex2DUtils::OverlayTextures(Sources[i], Overlay, Options);
+				});
+				const FString Formats = FString::Printf(TEXT("%s over DXT5 to %s"), GetPixelFormatString(BotFormat), GetPixelFormatString(OutFormat));
+				Report(TEXT("Overlay"), *Formats, Size, NumWorkers, Seconds);
+			}
+		}
+		/* Its decoded float mips would otherwise stay around for the rest of the session */
+		Th3Tex2DUtils::ReleaseOverlay(Overlay);
+	}
+}
+
+static FAutoConsoleCommand BenchmarkCommand(
+	TEXT("Th3.Benchmark"),
+	TEXT("Times the icon pipeline on synthetic mips. Arguments: sizes (default 64 256 1024 4096), Iterations=N (default 5)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunBenchmark));
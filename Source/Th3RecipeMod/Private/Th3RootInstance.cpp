@@ -23,6 +23,7 @@
 #include <Algo/Transform.h>
 #include <AssetRegistry/AssetRegistryModule.h>
 #include <Engine/AssetManager.h>
+#include <Patching/NativeHookManager.h>
 
 DEFINE_LOG_CATEGORY(LogTh3RootInstance);
 
@@ -33,6 +34,17 @@ UTh3RootInstance::UTh3RootInstance()
 
 UTh3RootInstance::~UTh3RootInstance()
 {
+	if (LazyIconTicker.IsValid()) {
+		FTSTicker::GetCoreTicker().RemoveTicker(LazyIconTicker);
+	}
+#if !WITH_EDITOR
+	if (SmallIconHook.IsValid()) {
+		UNSUBSCRIBE_METHOD(UFGItemDescriptor::GetSmallIcon, SmallIconHook);
+	}
+	if (BigIconHook.IsValid()) {
+		UNSUBSCRIBE_METHOD(UFGItemDescriptor::GetBigIcon, BigIconHook);
+	}
+#endif
 	UE_LOG(LogTh3RootInstance, Display, TEXT("Goodbye Cruel Game Instance"));
 }
 
@@ -108,6 +120,117 @@ UTexture2D* UTh3RootInstance::GetItemIcon(UFGItemDescriptor* OrigCDO)
 	}
 }
 
+Th3Tex2DUtils::FOverlayOptions UTh3RootInstance::GetIconOverlayOptions()
+{
+	Th3Tex2DUtils::FOverlayOptions Options;
+	switch (CompressedIconFormat) {
+	case ETh3IconFormat::BC1:
+		Options.OutputFormat = EPixelFormat::PF_DXT1;
+		break;
+	case ETh3IconFormat::BC3:
+		Options.OutputFormat = EPixelFormat::PF_DXT5;
+		break;
+	case ETh3IconFormat::Uncompressed:
+		Options.OutputFormat = EPixelFormat::PF_B8G8R8A8;
+		break;
+	}
+	Options.bRefineEndpoints = bRefineCompressedIcons;
+	Options.bUseCache = bCacheCompressedIcons;
+	Options.bDownsampleMips = bDownsampleCompressedIconMips;
+	Options.bDiscardCpuData = bDiscardCompressedIconCpuData;
+	Options.MaxSize = MaxCompressedIconSize;
+	Options.Atlas = bAtlasCompressedIcons ? &IconAtlas : nullptr;
+	return Options;
+}
+
+void UTh3RootInstance::SetCompressedIcon(UFGItemDescriptor* NewCDO, UTexture2D* Icon)
+{
+	NewCDO->mPersistentBigIcon = Icon;
+	NewCDO->mSmallIcon = Icon;
+}
+
+FSlateBrush UTh3RootInstance::GetCompressedIconBrush(TSubclassOf<UFGItemDescriptor> Item) const
+{
+	const UFGItemDescriptor* CDO = Item.GetDefaultObject();
+	UTexture2D* Icon = CDO ? CDO->mSmallIcon : nullptr;
+	const FAtlasSlot Slot = IconAtlas.Find(Icon);
+	if (Slot.IsValid()) {
+		return Slot.MakeBrush();
+	}
+	FSlateBrush Brush;
+	if (Icon) {
+		Brush.SetResourceObject(Icon);
+		Brush.ImageSize = FVector2D(Icon->GetSizeX(), Icon->GetSizeY());
+	}
+	return Brush;
+}
+
+void UTh3RootInstance::LoadIconOverlay()
+{
+	if (IsRunningDedicatedServer()) {
+		UE_LOG(LogTh3RootInstance, Display, TEXT("Dedicated server, compressed items keep the original icons"));
+		return;
+	}
+	IconOverlay = CompressedIconOverlay.LoadSynchronous();
+	if (not IconOverlay) {
+		UE_LOG(LogTh3RootInstance, Error, TEXT("Could not load icon overlay %s, compressed items keep the original icons"), *CompressedIconOverlay.ToString());
+		return;
+	}
+	Th3Tex2DUtils::PrepareOverlay(IconOverlay);
+#if WITH_EDITOR
+	/* Lazy icons are requested by the icon getter hooks, which do not exist in the editor */
+	if (bLazyCompressedIcons) {
+		UE_LOG(LogTh3RootInstance, Warning, TEXT("Lazy compressed icons are not supported in the editor, generating them all at startup"));
+		bLazyCompressedIcons = false;
+	}
+#endif
+	if (bLazyCompressedIcons) {
+		EnableLazyIcons();
+	}
+}
+
+void UTh3RootInstance::RequestLazyIcon(const TSubclassOf<UFGItemDescriptor>& Item)
+{
+	/* Icons can be looked up from anywhere, but the queue lives on the game thread */
+	if (not IsInGameThread()) {
+		return;
+	}
+	UTexture2D* BaseIcon = nullptr;
+	if (not LazyIconBases.RemoveAndCopyValue(Item, BaseIcon)) {
+		return;
+	}
+	UE_LOG(LogTh3RootInstance, Verbose, TEXT("Queueing lazy Item Icon for %s"), *Item->GetPathName());
+	UFGItemDescriptor* NewCDO = Item.GetDefaultObject();
+	LazyIconQueue.Add(BaseIcon, IconOverlay, GetIconOverlayOptions(), [this, NewCDO](UTexture2D* Icon) {
+		SetCompressedIcon(NewCDO, Icon);
+	});
+}
+
+bool UTh3RootInstance::TickLazyIcons(float DeltaTime)
+{
+	if (not LazyIconQueue.IsIdle()) {
+		LazyIconQueue.Tick(LazyIconBudgetMs / 1000.0);
+		/* Each upload is a whole page, outside the budget, so only the last one of a burst is immediate */
+		IconAtlas.Flush(LazyIconQueue.IsIdle() ? 0.0 : LAZY_ATLAS_FLUSH_SECONDS);
+	}
+	return true;
+}
+
+void UTh3RootInstance::EnableLazyIcons()
+{
+	UE_LOG(LogTh3RootInstance, Display, TEXT("Compressed item icons are generated on demand, %f ms per frame"), LazyIconBudgetMs);
+	LazyIconTicker = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &UTh3RootInstance::TickLazyIcons));
+#if !WITH_EDITOR
+	/* Whoever shows an icon asks for it through these, which is when it is worth generating */
+	SmallIconHook = SUBSCRIBE_METHOD(UFGItemDescriptor::GetSmallIcon, [this](auto& Scope, TSubclassOf<UFGItemDescriptor> InClass) {
+		RequestLazyIcon(InClass);
+	});
+	BigIconHook = SUBSCRIBE_METHOD(UFGItemDescriptor::GetBigIcon, [this](auto& Scope, TSubclassOf<UFGItemDescriptor> InClass) {
+		RequestLazyIcon(InClass);
+	});
+#endif
+}
+
 TSubclassOf<UFGItemDescriptor> UTh3RootInstance::CompressedFormOf(const TSubclassOf<UFGItemDescriptor>& OrigItem)
 {
 	TSubclassOf<UFGItemDescriptor>* NewItemPtr = ItemToCompressedMap.Find(OrigItem);
@@ -127,14 +250,25 @@ TSubclassOf<UFGItemDescriptor> UTh3RootInstance::CompressedFormOf(const TSubclas
 
 	UE_LOG(LogTh3RootInstance, Error, TEXT("ENERGY VALUE IS %f ---> %f FOR %s"), OrigCDO->mEnergyValue, NewCDO->mEnergyValue, *OrigItem->GetPathName());
 
-	UE_LOG(LogTh3RootInstance, Log, TEXT(" -  Compressing Item Icon for %s"), *OrigItem->GetPathName());
-
-	UTexture2D* OrigIcon = OrigCDO->mPersistentBigIcon ? OrigCDO->mPersistentBigIcon : OrigCDO->mSmallIcon;
-
-	NewCDO->mPersistentBigIcon = Th3Tex2DUtils::OverlayTextures(GetItemIcon(OrigCDO), CompressedIconOverlay);
-	NewCDO->mSmallIcon = NewCDO->mPersistentBigIcon;
+	/* Nobody sees icons on a dedicated server, the copied CDO keeps the original ones */
+	if (IconOverlay) {
+		UE_LOG(LogTh3RootInstance, Log, TEXT(" -  Compressing Item Icon for %s"), *OrigItem->GetPathName());
+
+		UTexture2D* OrigIcon = OrigCDO->mPersistentBigIcon ? OrigCDO->mPersistentBigIcon : OrigCDO->mSmallIcon;
+
+		/* The original icon stays as a placeholder until the overlay is done */
+		UTexture2D* BaseIcon = GetItemIcon(OrigCDO);
+		SetCompressedIcon(NewCDO, BaseIcon);
+		if (bLazyCompressedIcons) {
+			LazyIconBases.Add(NewItem, BaseIcon);
+		} else {
+			IconBatch.Add(BaseIcon, IconOverlay, GetIconOverlayOptions(), [this, NewCDO](UTexture2D* Icon) {
+				SetCompressedIcon(NewCDO, Icon);
+			});
+		}
 
-	UE_LOG(LogTh3RootInstance, Verbose, TEXT(" -  Successfully compressed Item Icon for %s"), *OrigItem->GetPathName());
+		UE_LOG(LogTh3RootInstance, Verbose, TEXT(" -  Queued Item Icon for %s"), *OrigItem->GetPathName());
+	}
 
 	MakeCompressionRecipes(OrigItem, NewItem);
 
@@ -383,6 +517,8 @@ void UTh3RootInstance::CompressAllSchematics()
 	};
 	const auto process_paths = [this]() {
 		Algo::ForEach(SchematicPtrs, TH3_PROJECTION_THIS(CompressOneSchematic));
+		IconBatch.Run();
+		IconAtlas.Flush();
 	};
 	Process(UFGSchematic::StaticClass(), store_paths, process_paths);
 }
@@ -399,6 +535,7 @@ void UTh3RootInstance::DispatchLifecycleEvent(ELifecyclePhase Phase)
 			UE_LOG(LogTh3RootInstance, Error, TEXT("Could not get Mod Content Registry, bailing out"));
 			return;
 		}
+		LoadIconOverlay();
 		CompressAllSchematics();
 		UE_LOG(LogTh3RootInstance, Display, TEXT("Got %d recipes, %d (de)compression recipes and %d compressed items"), RecipeToCompressedMap.Num(), RecipesToRegister.Num(), ItemToCompressedMap.Num());
 		Algo::ForEach(RecipesToRegister, [&Registry](const auto& Recipe) {
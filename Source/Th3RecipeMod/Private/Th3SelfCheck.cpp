@@ -0,0 +1,608 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#include "BlockMapper.h"
+#include "BlendKernels.h"
+#include "BCDecoder.h"
+#include "DXTDecoder.h"
+#include "DXTEncoder.h"
+#include "PlanarMip.h"
+#include "PreciseColor.h"
+
+#include <HAL/IConsoleManager.h>
+#include <HAL/PlatformFileManager.h>
+#include <Math/RandomStream.h>
+#include <Misc/FileHelper.h>
+#include <Misc/Paths.h>
+
+DEFINE_LOG_CATEGORY_STATIC(LogTh3SelfCheck, Log, All);
+
+/*
+ * Th3.SelfCheck [Record]
+ *
+ * Conformance checks for the decoders and blend kernels: hand-computed
+ * palettes for the DXT1/DXT5 corner cases, BC4 and a block of every BC7
+ * mode, the fast paths against the FPreciseColor reference, golden
+ * "over" results, and the float and fixed point precision policies
+ * against double. Also times the hot loops against a per-machine
+ * baseline, written by "Record", and fails any that got more than
+ * REGRESSION_FACTOR slower.
+ */
+
+static constexpr double REGRESSION_FACTOR = 2.0;
+static constexpr float DECODE_TOLERANCE = 1e-6f;
+/* One 16-bit step, fixed point decoding rounds the float decoded colors to the nearest one */
+static constexpr double FIXED16_DECODE_TOLERANCE = 1.0 / 0xffff;
+
+struct FSelfCheck
+{
+	int32 NumChecks = 0;
+	int32 NumFailed = 0;
+
+	void Expect(const bool bOk, const FString& What)
+	{
+		NumChecks++;
+		if (not bOk) {
+			NumFailed++;
+			UE_LOG(LogTh3SelfCheck, Error, TEXT("FAILED: %s"), *What);
+		}
+	}
+};
+
+/* Palette entries as the 565 expansion without low bit replication gives them, out of 255 */
+struct FGoldenColorBlock
+{
+	const TCHAR* Name;
+	uint16 Color0;
+	uint16 Color1;
+	/* The color half of a DXT5 block always has four colors */
+	bool bDXT5;
+	float Expected[4][4];
+};
+
+static const FGoldenColorBlock GOLDEN_COLOR_BLOCKS[] = {
+	{ TEXT("DXT1 Color0 > Color1"), 0xF800, 0x07E0, false, {
+		{ 248 / 255.0f, 0, 0, 1 },
+		{ 0, 252 / 255.0f, 0, 1 },
+		{ 2 * 248 / 765.0f, 252 / 765.0f, 0, 1 },
+		{ 248 / 765.0f, 2 * 252 / 765.0f, 0, 1 },
+	} },
+	{ TEXT("DXT1 Color0 < Color1"), 0x07E0, 0xF800, false, {
+		{ 0, 252 / 255.0f, 0, 1 },
+		{ 248 / 255.0f, 0, 0, 1 },
+		{ 124 / 255.0f, 126 / 255.0f, 0, 1 },
+		{ 0, 0, 0, 0 },
+	} },
+	{ TEXT("DXT1 Color0 == Color1"), 0xFFFF, 0xFFFF, false, {
+		{ 248 / 255.0f, 252 / 255.0f, 248 / 255.0f, 1 },
+		{ 248 / 255.0f, 252 / 255.0f, 248 / 255.0f, 1 },
+		{ 248 / 255.0f, 252 / 255.0f, 248 / 255.0f, 1 },
+		{ 0, 0, 0, 0 },
+	} },
+	{ TEXT("DXT5 Color0 < Color1"), 0x07E0, 0xF800, true, {
+		{ 0, 252 / 255.0f, 0, 1 },
+		{ 248 / 255.0f, 0, 0, 1 },
+		{ 248 / 765.0f, 2 * 252 / 765.0f, 0, 1 },
+		{ 2 * 248 / 765.0f, 252 / 765.0f, 0, 1 },
+	} },
+};
+
+struct FGoldenAlphaBlock
+{
+	const TCHAR* Name;
+	uint8 Alpha0;
+	uint8 Alpha1;
+	float Expected[8];
+};
+
+static const FGoldenAlphaBlock GOLDEN_ALPHA_BLOCKS[] = {
+	{ TEXT("DXT5 Alpha0 > Alpha1"), 0xff, 0x00, { 1, 0, 6 / 7.0f, 5 / 7.0f, 4 / 7.0f, 3 / 7.0f, 2 / 7.0f, 1 / 7.0f } },
+	{ TEXT("DXT5 Alpha0 < Alpha1"), 0x00, 0xff, { 0, 1, 1 / 5.0f, 2 / 5.0f, 3 / 5.0f, 4 / 5.0f, 0, 1 } },
+	{ TEXT("DXT5 Alpha0 == Alpha1"), 0x80, 0x80, { 128 / 255.0f, 128 / 255.0f, 128 / 255.0f, 128 / 255.0f, 128 / 255.0f, 128 / 255.0f, 0, 1 } },
+};
+
+/* Bot, Top, then Top over Bot with straight alpha */
+static const FLinearColor GOLDEN_OVER[][3] = {
+	{ { 1, 0, 0, 1 }, { 0, 0, 1, 0.5f }, { 0.5f, 0, 0.5f, 1 } },
+	{ { 1, 0, 0, 0.5f }, { 0, 1, 0, 0.5f }, { 1 / 3.0f, 2 / 3.0f, 0, 0.75f } },
+	{ { 1, 1, 1, 1 }, { 0, 0, 0, 0 }, { 1, 1, 1, 1 } },
+	{ { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 } },
+};
+
+/* Pixel i gets code i % 4, and alpha code i % 8 */
+static const uint32 EVERY_COLOR_CODE = 0xE4E4E4E4;
+
+static uint64 GetEveryAlphaCode()
+{
+	uint64 Bits = 0;
+	for (int32 i = 0; i < 16; i++) {
+		Bits |= static_cast<uint64>(i % 8) << (3 * i);
+	}
+	return Bits;
+}
+
+static FDXT5 MakeDXT5(const uint16 Color0, const uint16 Color1, const uint8 Alpha0, const uint8 Alpha1)
+{
+	FDXT5 Block;
+	Block.DXT1.Color[0].Value = Color0;
+	Block.DXT1.Color[1].Value = Color1;
+	Block.DXT1.Indices = EVERY_COLOR_CODE;
+	Block.Alpha[0] = Alpha0;
+	Block.Alpha[1] = Alpha1;
+	const uint64 AlphaBits = GetEveryAlphaCode();
+	for (int32 i = 0; i < 6; i++) {
+		Block.Alpha[2 + i] = static_cast<uint8>(AlphaBits >> (8 * i));
+	}
+	return Block;
+}
+
+static bool IsNear(const FPlanarBlock& Block, const int32 i, const float R, const float G, const float B, const float A)
+{
+	return FMath::IsNearlyEqual(Block.R[i], R, DECODE_TOLERANCE) and FMath::IsNearlyEqual(Block.G[i], G, DECODE_TOLERANCE)
+		and FMath::IsNearlyEqual(Block.B[i], B, DECODE_TOLERANCE) and FMath::IsNearlyEqual(Block.A[i], A, DECODE_TOLERANCE);
+}
+
+static bool IsSame(const FPlanarBlock& A, const FPlanarBlock& B)
+{
+	return FMemory::Memcmp(&A, &B, sizeof(FPlanarBlock)) == 0;
+}
+
+static void CheckGoldenBlocks(FSelfCheck& Check)
+{
+	for (const FGoldenColorBlock& Golden : GOLDEN_COLOR_BLOCKS) {
+		const FDXT5 Block = MakeDXT5(Golden.Color0, Golden.Color1, 0xff, 0xff);
+		FPlanarBlock Fast, Scalar;
+		if (Golden.bDXT5) {
+			DXTDecoder::DecodeDXT5(Fast, Block);
+			DXTDecoder::DecodeDXT5Scalar(Scalar, Block);
+		} else {
+			DXTDecoder::DecodeDXT1(Fast, Block.DXT1);
+			DXTDecoder::DecodeDXT1Scalar(Scalar, Block.DXT1);
+		}
+		for (int32 i = 0; i < 16; i++) {
+			const float* E = Golden.Expected[i % 4];
+			/* DXT5 alpha comes from the alpha half, all 0xff here */
+			const float A = Golden.bDXT5 ? 1.0f : E[3];
+			Check.Expect(IsNear(Fast, i, E[0], E[1], E[2], A), FString::Printf(TEXT("%s, pixel %d"), Golden.Name, i));
+			Check.Expect(IsNear(Scalar, i, E[0], E[1], E[2], A), FString::Printf(TEXT("%s (scalar), pixel %d"), Golden.Name, i));
+		}
+	}
+	for (const FGoldenAlphaBlock& Golden : GOLDEN_ALPHA_BLOCKS) {
+		const FDXT5 Block = MakeDXT5(0xF800, 0x07E0, Golden.Alpha0, Golden.Alpha1);
+		FPlanarBlock Fast, Scalar;
+		DXTDecoder::DecodeDXT5(Fast, Block);
+		DXTDecoder::DecodeDXT5Scalar(Scalar, Block);
+		for (int32 i = 0; i < 16; i++) {
+			const float A = Golden.Expected[i % 8];
+			Check.Expect(FMath::IsNearlyEqual(Fast.A[i], A, DECODE_TOLERANCE), FString::Printf(TEXT("%s, pixel %d (code %d)"), Golden.Name, i, i % 8));
+			Check.Expect(FMath::IsNearlyEqual(Scalar.A[i], A, DECODE_TOLERANCE), FString::Printf(TEXT("%s (scalar), pixel %d (code %d)"), Golden.Name, i, i % 8));
+		}
+	}
+}
+
+/* Mode 6, every channel from 0 (P bit 0) to 255 (127 with P bit 1), pixel i uses index i */
+static FBC7 MakeBC7Ramp()
+{
+	uint64 Bits[2] = {};
+	int32 Pos = 0;
+	auto Put = [&Bits, &Pos](const uint64 Value, const int32 NumBits) {
+		for (int32 b = 0; b < NumBits; b++, Pos++) {
+			Bits[Pos / 64] |= ((Value >> b) & 1) << (Pos % 64);
+		}
+	};
+	Put(1 << 6, 7);
+	for (int32 c = 0; c < 4; c++) {
+		Put(0, 7);
+		Put(127, 7);
+	}
+	Put(0, 1);
+	Put(1, 1);
+	/* The anchor index drops its top bit */
+	for (int32 i = 0; i < 16; i++) {
+		Put(i, i == 0 ? 3 : 4);
+	}
+	return { .Lo = Bits[0], .Hi = Bits[1] };
+}
+
+static const uint8 GOLDEN_BC7_RAMP[16] = { 0, 16, 36, 52, 68, 84, 104, 120, 135, 151, 171, 187, 203, 219, 239, 255 };
+
+struct FGoldenBC7Block
+{
+	const TCHAR* Name;
+	FBC7 Block;
+	/* 0xRRGGBBAA */
+	uint32 Expected[16];
+};
+
+/*
+ * Random bits with the mode, partition, rotation and index selection set,
+ * so endpoints and P-bits vary too. Expected pixels come from a separate
+ * decoder (Pillow's BC7 decoder), not from this one.
+ */
+static const FGoldenBC7Block GOLDEN_BC7_BLOCKS[] = {
+	{ TEXT("Mode 0, partition 13"), { .Lo = 0xF2A74DE452E6B43BULL, .Hi = 0x6513270E269E0D37ULL }, {
+		0x4F216EFF, 0x3FA1D1FF, 0x974972FF, 0x8E6A80FF, 0x102152FF, 0x44B9DBFF, 0x809D95FF, 0x8E6A80FF,
+		0x4F216EFF, 0x49CDE4FF, 0x974972FF, 0x8E6A80FF, 0x102152FF, 0x3A8DC8FF, 0x8E6A80FF, 0x809D95FF,
+	} },
+	{ TEXT("Mode 1, partition 34"), { .Lo = 0x0C5C7FD0A6A3A48AULL, .Hi = 0xD23F0824128B2F33ULL }, {
+		0x7A7732FF, 0xAB1ECFFF, 0x53CA32FF, 0xA94372FF, 0xAB1ECFFF, 0x60AF32FF, 0xAB1ECFFF, 0x865D32FF,
+		0x934232FF, 0xAA27B8FF, 0x60AF32FF, 0xA75E2EFF, 0xA9398BFF, 0x60AF32FF, 0xA94372FF, 0x47E432FF,
+	} },
+	{ TEXT("Mode 2, partition 63"), { .Lo = 0x1818E811892F91FCULL, .Hi = 0x9531985D5D9DC9F8ULL }, {
+		0x7D7E83FF, 0x3443D9FF, 0x3443D9FF, 0x2963DEFF, 0x631873FF, 0xF77394FF, 0x2963DEFF, 0x4A00CEFF,
+		0x631873FF, 0x631873FF, 0xF77394FF, 0x2963DEFF, 0x4D5186FF, 0x4D5186FF, 0x4D5186FF, 0xBC798CFF,
+	} },
+	{ TEXT("Mode 3, partition 17"), { .Lo = 0xE8E25D940ED90518ULL, .Hi = 0x36F675CC81E74EF5ULL }, {
+		0x9FAB6CFF, 0x2D3B8CFF, 0x1C1CCEFF, 0x507A06FF, 0x9FAB6CFF, 0x9FAB6CFF, 0xD9254FFF, 0x2D3B8CFF,
+		0xBC665DFF, 0x9FAB6CFF, 0xD9254FFF, 0xD9254FFF, 0xBC665DFF, 0x9FAB6CFF, 0xD9254FFF, 0x82EC7AFF,
+	} },
+	{ TEXT("Mode 4, no rotation"), { .Lo = 0x1600A35A09995010ULL, .Hi = 0x6B0D549B6F03675AULL }, {
+		0x84310032, 0x84310034, 0x8431002D, 0x84310028, 0x529C6B2A, 0x6279482A, 0x8431002A, 0x8431002D,
+		0x7454232D, 0x529C6B31, 0x6279482B, 0x6279482A, 0x529C6B34, 0x8431002A, 0x529C6B31, 0x6279482F,
+	} },
+	{ TEXT("Mode 4, rotation 2, index selection"), { .Lo = 0x3D9C172411E20BD0ULL, .Hi = 0x8D116ECE1738F7D9ULL }, {
+		0x5A4D08C6, 0x84049418, 0x72715961, 0x6C04437D, 0x60281CAE, 0x72045961, 0x6C4D437D, 0x7E288030,
+		0x7E718030, 0x78046D49, 0x78286D49, 0x5A0408C6, 0x60041CAE, 0x66282F95, 0x6C04437D, 0x724D5961,
+	} },
+	{ TEXT("Mode 5, no rotation"), { .Lo = 0x0F21DDB66CAD4A20ULL, .Hi = 0x90C192CFD3AC94AFULL }, {
+		0xA065A2C6, 0xA065A2C3, 0xA065A2C8, 0xA065A2C3, 0xAB658BC5, 0xAB658BC8, 0x9564B7C6, 0xA065A2C5,
+		0xAB658BC6, 0xA065A2C8, 0xA065A2C8, 0xB56676C3, 0xA065A2C8, 0xAB658BC8, 0xAB658BC6, 0xB56676C5,
+	} },
+	{ TEXT("Mode 5, rotation 3"), { .Lo = 0xF28C105D1FB17CE0ULL, .Hi = 0xA170B33839263059ULL }, {
+		0xF9FDA30A, 0xC5D18904, 0xD6DF7C06, 0xF9FDA30A, 0xF9FD7C0A, 0xD6DFA306, 0xE8EF7C08, 0xF9FD890A,
+		0xC5D1A304, 0xF9FDA30A, 0xE8EF7C08, 0xD6DF9606, 0xF9FD960A, 0xC5D1A304, 0xE8EF8908, 0xF9FD890A,
+	} },
+	{ TEXT("Mode 6"), { .Lo = 0x953F48F1A09F76C0ULL, .Hi = 0x0FD630F1F29D0DA9ULL }, {
+		0xE415593A, 0xF1278332, 0xF72F962E, 0xDB093D3F, 0xF72F962E, 0xEE237B33, 0xE00F4C3C, 0xFB35A52B,
+		0xDD0C443E, 0xFB35A52B, 0xDB093D3F, 0xE212523B, 0xE81B6737, 0xF72F962E, 0xFB35A52B, 0xDB093D3F,
+	} },
+	{ TEXT("Mode 7, partition 50"), { .Lo = 0x95E60AF593BD3280ULL, .Hi = 0x0CB1E29C658CDA14ULL }, {
+		0xADD8B0BD, 0xBAAA92CB, 0xA6EFBEB6, 0xADD8B0BD, 0xADD8B0BD, 0xA6EFBEB6, 0x873398B3, 0xBAAA92CB,
+		0xADD8B0BD, 0x9A00A2C3, 0x619A8292, 0x74678DA2, 0xA6EFBEB6, 0xBAAA92CB, 0x9A00A2C3, 0xA6EFBEB6,
+	} },
+};
+
+static void CheckGoldenBCBlocks(FSelfCheck& Check)
+{
+	/* BC4 is the DXT5 alpha half on its own, in red */
+	for (const FGoldenAlphaBlock& Golden : GOLDEN_ALPHA_BLOCKS) {
+		const FDXT5 Source = MakeDXT5(0, 0, Golden.Alpha0, Golden.Alpha1);
+		FBC4 Block;
+		FMemory::Memcpy(Block.Red, Source.Alpha, sizeof(Block.Red));
+		FPlanarBlock Out;
+		BCDecoder::DecodeBC4(Out, Block);
+		for (int32 i = 0; i < 16; i++) {
+			Check.Expect(IsNear(Out, i, Golden.Expected[i % 8], 0, 0, 1), FString::Printf(TEXT("BC4 from %s, pixel %d"), Golden.Name, i));
+		}
+	}
+	FPlanarBlock Out;
+	BCDecoder::DecodeBC7(Out, MakeBC7Ramp());
+	for (int32 i = 0; i < 16; i++) {
+		const float E = GOLDEN_BC7_RAMP[i] / 255.0f;
+		Check.Expect(IsNear(Out, i, E, E, E, E), FString::Printf(TEXT("BC7 mode 6 ramp, pixel %d"), i));
+	}
+	for (const FGoldenBC7Block& Golden : GOLDEN_BC7_BLOCKS) {
+		BCDecoder::DecodeBC7(Out, Golden.Block);
+		for (int32 i = 0; i < 16; i++) {
+			const uint32 E = Golden.Expected[i];
+			const bool bNear = IsNear(Out, i, (E >> 24) / 255.0f, ((E >> 16) & 0xFF) / 255.0f, ((E >> 8) & 0xFF) / 255.0f, (E & 0xFF) / 255.0f);
+			Check.Expect(bNear, FString::Printf(TEXT("BC7 %s, pixel %d"), Golden.Name, i));
+		}
+	}
+}
+
+/* Random blocks hit every ordering of the endpoints, the fast decoders must match the scalar ones bit for bit */
+static void CheckFastDecoders(FSelfCheck& Check, FRandomStream& Random)
+{
+	const int32 NUM_BLOCKS = 4096;
+	int32 NumMismatched1 = 0;
+	int32 NumMismatched5 = 0;
+	for (int32 n = 0; n < NUM_BLOCKS; n++) {
+		FDXT5 Block;
+		uint8* Bytes = reinterpret_cast<uint8*>(&Block);
+		for (int32 i = 0; i < static_cast<int32>(sizeof(FDXT5)); i++) {
+			Bytes[i] = static_cast<uint8>(Random.RandHelper(256));
+		}
+		FPlanarBlock Fast, Scalar;
+		DXTDecoder::DecodeDXT1(Fast, Block.DXT1);
+		DXTDecoder::DecodeDXT1Scalar(Scalar, Block.DXT1);
+		NumMismatched1 += IsSame(Fast, Scalar) ? 0 : 1;
+		DXTDecoder::DecodeDXT5(Fast, Block);
+		DXTDecoder::DecodeDXT5Scalar(Scalar, Block);
+		NumMismatched5 += IsSame(Fast, Scalar) ? 0 : 1;
+	}
+	Check.Expect(NumMismatched1 == 0, FString::Printf(TEXT("DecodeDXT1 differs from DecodeDXT1Scalar on %d of %d blocks"), NumMismatched1, NUM_BLOCKS));
+	Check.Expect(NumMismatched5 == 0, FString::Printf(TEXT("DecodeDXT5 differs from DecodeDXT5Scalar on %d of %d blocks"), NumMismatched5, NUM_BLOCKS));
+}
+
+/* Whole mips through BlockMapper over plain memory, planar decoding against the FPreciseColor blocks */
+static void CheckMipDecoding(FSelfCheck& Check, FRandomStream& Random)
+{
+	const int32 SIZE = 64;
+	for (const EPixelFormat Format : { EPixelFormat::PF_DXT1, EPixelFormat::PF_DXT5, EPixelFormat::PF_B8G8R8A8 }) {
+		const FPixelFormatInfo& FmtInfo = GPixelFormats[Format];
+		TArray64<uint8> Bytes;
+		Bytes.SetNumUninitialized((SIZE / FmtInfo.BlockSizeX) * (SIZE / FmtInfo.BlockSizeY) * FmtInfo.BlockBytes);
+		for (uint8& Byte : Bytes) {
+			Byte = static_cast<uint8>(Random.RandHelper(256));
+		}
+
+		const BlockMapper Mapper(FMipMemory{ .Data = Bytes.GetData(), .NumBytes = Bytes.Num(), .SizeX = SIZE, .SizeY = SIZE, .Format = Format });
+		FPlanarMip Mip;
+		Mapper.DecodeMip(Mip);
+		double MaxError = 0;
+		for (int32 y = 0; y < SIZE; y += MAX_BLOCK_SIDE) {
+			for (int32 x = 0; x < SIZE; x += MAX_BLOCK_SIDE) {
+				const FPreciseBlock Block = Mapper.ReadBlock(x, y);
+				for (int32 i = 0; i < 16; i++) {
+					const int32 Idx = (y + i / 4) * SIZE + x + i % 4;
+					const FPreciseColor& Ref = Block.Data[i];
+					MaxError = FMath::Max(MaxError, FMath::Abs(Mip.R()[Idx] - Ref.R));
+					MaxError = FMath::Max(MaxError, FMath::Abs(Mip.G()[Idx] - Ref.G));
+					MaxError = FMath::Max(MaxError, FMath::Abs(Mip.B()[Idx] - Ref.B));
+					MaxError = FMath::Max(MaxError, FMath::Abs(Mip.A()[Idx] - Ref.A));
+				}
+			}
+		}
+		Check.Expect(MaxError <= DECODE_TOLERANCE, FString::Printf(TEXT("%s planar decoding is off by %g from the reference"), GetPixelFormatString(Format), MaxError));
+	}
+}
+
+/* Largest difference from FPreciseColor::Over of any channel, optionally with colors weighted by the coverage they end up with */
+template<typename PolicyT>
+static double GetOverError(const TPlanarMip<PolicyT>& Out, const FPlanarMip& Bot, const FPlanarMip& Top, const bool bWeightByCoverage)
+{
+	double MaxError = 0;
+	for (int32 i = 0; i < Out.Num(); i++) {
+		const FPreciseColor Ref = FPreciseColor::Over(
+			FPreciseColor(Bot.R()[i], Bot.G()[i], Bot.B()[i], Bot.A()[i]),
+			FPreciseColor(Top.R()[i], Top.G()[i], Top.B()[i], Top.A()[i]));
+		const double RefPlanes[4] = { Ref.R, Ref.G, Ref.B, Ref.A };
+		for (int32 c = 0; c < 4; c++) {
+			const double Weight = bWeightByCoverage and c < 3 ? Ref.A : 1.0;
+			MaxError = FMath::Max(MaxError, Weight * FMath::Abs(PolicyT::ToDouble(Out.Plane(c)[i]) - RefPlanes[c]));
+		}
+	}
+	return MaxError;
+}
+
+static void CheckOver(FSelfCheck& Check, FRandomStream& Random)
+{
+	for (const FLinearColor* Golden : GOLDEN_OVER) {
+		const FPreciseColor Ref = FPreciseColor::Over(Golden[0], Golden[1]);
+		const FPreciseColor Expected(Golden[2]);
+		const bool bOk = FMath::IsNearlyEqual(Ref.R, Expected.R, 1e-6) and FMath::IsNearlyEqual(Ref.G, Expected.G, 1e-6)
+			and FMath::IsNearlyEqual(Ref.B, Expected.B, 1e-6) and FMath::IsNearlyEqual(Ref.A, Expected.A, 1e-6);
+		Check.Expect(bOk, FString::Printf(TEXT("FPreciseColor::Over of %s under %s is %s"), *Golden[0].ToString(), *Golden[1].ToString(), *Ref.ToString()));
+	}
+
+	/* Golden pixels first, random ones after */
+	const int32 NUM_PIXELS = 4096;
+	const int32 NUM_GOLDEN = UE_ARRAY_COUNT(GOLDEN_OVER);
+	FPlanarMip Bot(NUM_PIXELS, 1), Top(NUM_PIXELS, 1);
+	for (int32 i = 0; i < NUM_PIXELS; i++) {
+		const int32 g = i % NUM_GOLDEN;
+		const bool bGolden = i < NUM_GOLDEN;
+		for (int32 c = 0; c < 4; c++) {
+			Bot.Plane(c)[i] = bGolden ? GOLDEN_OVER[g][0].Component(c) : Random.GetFraction();
+			Top.Plane(c)[i] = bGolden ? GOLDEN_OVER[g][1].Component(c) : Random.GetFraction();
+		}
+	}
+	FPlanarMip Fast, Scalar;
+	BlendKernels::OverStraight(Fast, Bot, Top);
+	BlendKernels::OverStraightScalar(Scalar, Bot, Top);
+	const double StraightError = FMath::Max(GetOverError(Fast, Bot, Top, false), GetOverError(Scalar, Bot, Top, false));
+	Check.Expect(StraightError <= BlendKernels::OVER_TOLERANCE, FString::Printf(TEXT("OverStraight is off by %g from FPreciseColor::Over"), StraightError));
+
+	/* The premultiplied pipeline end to end: Premultiply, OverPremultiplied, Unpremultiply */
+	FPlanarMip PremulBot = Bot, PremulTop = Top;
+	BlendKernels::Premultiply(PremulBot);
+	BlendKernels::Premultiply(PremulTop);
+	BlendKernels::OverPremultiplied(Fast, PremulBot, PremulTop);
+	BlendKernels::OverPremultipliedScalar(Scalar, PremulBot, PremulTop);
+	BlendKernels::Unpremultiply(Fast);
+	BlendKernels::Unpremultiply(Scalar);
+	const double PremulError = FMath::Max(GetOverError(Fast, Bot, Top, false), GetOverError(Scalar, Bot, Top, false));
+	Check.Expect(PremulError <= BlendKernels::OVER_TOLERANCE, FString::Printf(TEXT("OverPremultiplied round trip is off by %g from FPreciseColor::Over"), PremulError));
+
+	/* Premultiply leaves nearly transparent pixels only a few fixed point steps of color, which only count as far as they are visible */
+	TPlanarMip<FFixed16Precision> FixedBot, FixedTop, FixedOut;
+	Bot.ConvertTo(FixedBot);
+	Top.ConvertTo(FixedTop);
+	BlendKernels::Premultiply(FixedBot);
+	BlendKernels::Premultiply(FixedTop);
+	BlendKernels::OverPremultiplied(FixedOut, FixedBot, FixedTop);
+	BlendKernels::Unpremultiply(FixedOut);
+	const double FixedError = GetOverError(FixedOut, Bot, Top, true);
+	Check.Expect(FixedError <= BlendKernels::FIXED16_OVER_TOLERANCE, FString::Printf(TEXT("Fixed16 OverPremultiplied round trip is off by %g from FPreciseColor::Over"), FixedError));
+}
+
+/* Largest difference of any value of Mip from the same value of Ref */
+template<typename PolicyT>
+static double GetMaxDifference(const TPlanarMip<PolicyT>& Mip, const TPlanarMip<FDoublePrecision>& Ref)
+{
+	double MaxError = 0;
+	for (int32 i = 0; i < Ref.Data.Num(); i++) {
+		MaxError = FMath::Max(MaxError, FMath::Abs(PolicyT::ToDouble(Mip.Data[i]) - Ref.Data[i]));
+	}
+	return MaxError;
+}
+
+/* A precision policy against FDoublePrecision: decoding, both "over" kernels and the quantization to 8 bits */
+template<typename PolicyT>
+static void CheckPrecisionPolicy(FSelfCheck& Check, FRandomStream& Random, const TCHAR* Name, const double DecodeTolerance, const double OverTolerance)
+{
+	const int32 SIZE = 64;
+	for (const EPixelFormat Format : { EPixelFormat::PF_DXT1, EPixelFormat::PF_DXT5 }) {
+		const FPixelFormatInfo& FmtInfo = GPixelFormats[Format];
+		TArray64<uint8> Bytes;
+		Bytes.SetNumUninitialized((SIZE / FmtInfo.BlockSizeX) * (SIZE / FmtInfo.BlockSizeY) * FmtInfo.BlockBytes);
+		for (uint8& Byte : Bytes) {
+			Byte = static_cast<uint8>(Random.RandHelper(256));
+		}
+
+		const BlockMapper Mapper(FMipMemory{ .Data = Bytes.GetData(), .NumBytes = Bytes.Num(), .SizeX = SIZE, .SizeY = SIZE, .Format = Format });
+		TPlanarMip<FDoublePrecision> Ref;
+		TPlanarMip<PolicyT> Mip;
+		Mapper.DecodeMip(Ref);
+		Mapper.DecodeMip(Mip);
+		const double Error = GetMaxDifference(Mip, Ref);
+		Check.Expect(Error <= DecodeTolerance, FString::Printf(TEXT("%s decoding of %s is off by %g from double"), Name, GetPixelFormatString(Format), Error));
+	}
+
+	TPlanarMip<FDoublePrecision> Bot(SIZE, SIZE), Top(SIZE, SIZE), RefOut;
+	for (int32 i = 0; i < Bot.Data.Num(); i++) {
+		Bot.Data[i] = Random.GetFraction();
+		Top.Data[i] = Random.GetFraction();
+	}
+	TPlanarMip<PolicyT> PolicyBot, PolicyTop, PolicyOut;
+	Bot.ConvertTo(PolicyBot);
+	Top.ConvertTo(PolicyTop);
+	BlendKernels::OverStraight(RefOut, Bot, Top);
+	BlendKernels::OverStraight(PolicyOut, PolicyBot, PolicyTop);
+	const double StraightError = GetMaxDifference(PolicyOut, RefOut);
+	Check.Expect(StraightError <= OverTolerance, FString::Printf(TEXT("%s OverStraight is off by %g from double"), Name, StraightError));
+
+	BlendKernels::Premultiply(Bot);
+	BlendKernels::Premultiply(Top);
+	BlendKernels::Premultiply(PolicyBot);
+	BlendKernels::Premultiply(PolicyTop);
+	BlendKernels::OverPremultiplied(RefOut, Bot, Top);
+	BlendKernels::OverPremultiplied(PolicyOut, PolicyBot, PolicyTop);
+	const double PremulError = GetMaxDifference(PolicyOut, RefOut);
+	Check.Expect(PremulError <= OverTolerance, FString::Printf(TEXT("%s OverPremultiplied is off by %g from double"), Name, PremulError));
+
+	/* Every 16-bit value, which for fixed point covers the whole linear and sRGB tables */
+	int32 NumMismatched = 0;
+	for (int32 i = 0; i <= 0xffff; i++) {
+		const typename PolicyT::Scalar Value = PolicyT::FromDouble(i / 65535.0);
+		for (const bool bSRGB : { false, true }) {
+			NumMismatched += PolicyT::ToUnorm8(Value, bSRGB) == FDoublePrecision::ToUnorm8(PolicyT::ToDouble(Value), bSRGB) ? 0 : 1;
+		}
+	}
+	Check.Expect(NumMismatched == 0, FString::Printf(TEXT("%s ToUnorm8 quantizes %d values differently from double"), Name, NumMismatched));
+}
+
+static void CheckPrecisionPolicies(FSelfCheck& Check, FRandomStream& Random)
+{
+	CheckPrecisionPolicy<FFloatPrecision>(Check, Random, TEXT("Float"), DECODE_TOLERANCE, BlendKernels::OVER_TOLERANCE);
+	CheckPrecisionPolicy<FFixed16Precision>(Check, Random, TEXT("Fixed16"), FIXED16_DECODE_TOLERANCE, BlendKernels::FIXED16_OVER_TOLERANCE);
+}
+
+/* ns per 4x4 block, best of a few runs */
+template<typename FuncT>
+static double TimePerBlock(const int32 NumBlocks, FuncT&& Func)
+{
+	double Best = TNumericLimits<double>::Max();
+	for (int32 Run = 0; Run < 5; Run++) {
+		const double Begin = FPlatformTime::Seconds();
+		Func();
+		Best = FMath::Min(Best, FPlatformTime::Seconds() - Begin);
+	}
+	return Best * 1e9 / NumBlocks;
+}
+
+static TMap<FString, double> MeasureTimings(FRandomStream& Random)
+{
+	const int32 NUM_BLOCKS = 16384;
+	TArray<FDXT5> Blocks;
+	Blocks.SetNumUninitialized(NUM_BLOCKS);
+	for (FDXT5& Block : Blocks) {
+		uint8* Bytes = reinterpret_cast<uint8*>(&Block);
+		for (int32 i = 0; i < static_cast<int32>(sizeof(FDXT5)); i++) {
+			Bytes[i] = static_cast<uint8>(Random.RandHelper(256));
+		}
+	}
+	TArray<FPlanarBlock> Decoded;
+	Decoded.SetNumUninitialized(NUM_BLOCKS);
+
+	TMap<FString, double> Timings;
+	Timings.Add(TEXT("DecodeDXT1"), TimePerBlock(NUM_BLOCKS, [&]() {
+		for (int32 i = 0; i < NUM_BLOCKS; i++) {
+			DXTDecoder::DecodeDXT1(Decoded[i], Blocks[i].DXT1);
+		}
+	}));
+	Timings.Add(TEXT("DecodeDXT5"), TimePerBlock(NUM_BLOCKS, [&]() {
+		for (int32 i = 0; i < NUM_BLOCKS; i++) {
+			DXTDecoder::DecodeDXT5(Decoded[i], Blocks[i]);
+		}
+	}));
+	Timings.Add(TEXT("EncodeDXT5"), TimePerBlock(NUM_BLOCKS, [&]() {
+		for (int32 i = 0; i < NUM_BLOCKS; i++) {
+			DXTEncoder::EncodeDXT5(Blocks[i], Decoded[i], { .bRefine = true });
+		}
+	}));
+	FPlanarMip Bot(256, 256), Top(256, 256), Out;
+	for (int32 i = 0; i < Bot.Data.Num(); i++) {
+		Bot.Data[i] = Random.GetFraction();
+		Top.Data[i] = Random.GetFraction();
+	}
+	Timings.Add(TEXT("OverStraight"), TimePerBlock(Bot.Num() / 16, [&]() {
+		BlendKernels::OverStraight(Out, Bot, Top);
+	}));
+	return Timings;
+}
+
+static FString GetBaselinePath()
+{
+	return FPaths::ProjectSavedDir() / TEXT("Th3RecipeMod") / TEXT("SelfCheckBaseline.txt");
+}
+
+static void CheckTimings(FSelfCheck& Check, FRandomStream& Random, const bool bRecord)
+{
+	const TMap<FString, double> Timings = MeasureTimings(Random);
+	for (const TPair<FString, double>& Timing : Timings) {
+		UE_LOG(LogTh3SelfCheck, Display, TEXT("%-14s %8.1f ns/block"), *Timing.Key, Timing.Value);
+	}
+
+	const FString Path = GetBaselinePath();
+	if (bRecord) {
+		FString Text;
+		for (const TPair<FString, double>& Timing : Timings) {
+			Text += FString::Printf(TEXT("%s %f\n"), *Timing.Key, Timing.Value);
+		}
+		FPlatformFileManager::Get().GetPlatformFile().CreateDirectoryTree(*FPaths::GetPath(Path));
+		Check.Expect(FFileHelper::SaveStringToFile(Text, *Path), FString::Printf(TEXT("Could not write %s"), *Path));
+		UE_LOG(LogTh3SelfCheck, Display, TEXT("Recorded the timing baseline in %s"), *Path);
+		return;
+	}
+
+	TArray<FString> Lines;
+	if (not FFileHelper::LoadFileToStringArray(Lines, *Path)) {
+		UE_LOG(LogTh3SelfCheck, Display, TEXT("No timing baseline yet, run 'Th3.SelfCheck Record' to make one"));
+		return;
+	}
+	for (const FString& Line : Lines) {
+		FString Name, Value;
+		if (not Line.Split(TEXT(" "), &Name, &Value)) {
+			continue;
+		}
+		const double Baseline = FCString::Atod(*Value);
+		if (const double* Current = Timings.Find(Name)) {
+			Check.Expect(*Current <= Baseline * REGRESSION_FACTOR, FString::Printf(TEXT("%s regressed from %.1f to %.1f ns/block"), *Name, Baseline, *Current));
+		}
+	}
+}
+
+static void RunSelfCheck(const TArray<FString>& Args)
+{
+	const bool bRecord = Args.Contains(TEXT("Record"));
+	FRandomStream Random(0x7E3);
+	FSelfCheck Check;
+	CheckGoldenBlocks(Check);
+	CheckGoldenBCBlocks(Check);
+	CheckFastDecoders(Check, Random);
+	CheckMipDecoding(Check, Random);
+	CheckOver(Check, Random);
+	CheckPrecisionPolicies(Check, Random);
+	CheckTimings(Check, Random, bRecord);
+	if (Check.NumFailed > 0) {
+		UE_LOG(LogTh3SelfCheck, Error, TEXT("%d of %d checks failed"), Check.NumFailed, Check.NumChecks);
+	} else {
+		UE_LOG(LogTh3SelfCheck, Display, TEXT("All %d checks passed"), Check.NumChecks);
+	}
+}
+
+static FAutoConsoleCommand SelfCheckCommand(
+	TEXT("Th3.SelfCheck"),
+	TEXT("Checks the decoders and blend kernels against golden results and the timing baseline. 'Record' saves a new baseline"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunSelfCheck));
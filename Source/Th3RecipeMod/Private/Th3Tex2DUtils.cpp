@@ -4,8 +4,16 @@
 #include "Th3Utilities.h"
 #include "BlockMapper.h"
 #include "PreciseColor.h"
+#include "PlanarMip.h"
+#include "BlendKernels.h"
+#include "TextureCache.h"
+#include "TextureResidency.h"
 
 #include <Algo/Accumulate.h>
+#include <Async/ParallelFor.h>
+#include <Hash/xxhash.h>
+#include <Tasks/Task.h>
+#include <UObject/ObjectKey.h>
 #include <Math/Color.h>
 
 DEFINE_LOG_CATEGORY(LogTh3Tex2DUtils);
@@ -29,7 +37,18 @@ struct TextureParams
 	bool bSuccess;
 };
 
-static const EPixelFormat OUTPUT_FORMAT = EPixelFormat::PF_B8G8R8A8;
+/* Part of every texture cache key, bump it whenever generated textures would change */
+static const uint32 PIPELINE_VERSION = 2;
+
+/* Blend in premultiplied alpha, converting back only right before encoding */
+static constexpr bool USE_PREMULTIPLIED_ALPHA = false;
+
+/*
+ * Working precision of the whole pipeline, see ColorPrecision.h:
+ * FDoublePrecision (reference), FFloatPrecision or FFixed16Precision
+ */
+using FOverlayPrecision = FFloatPrecision;
+using FOverlayMip = TPlanarMip<FOverlayPrecision>;
 
 static bool IsFormatSupported(const EPixelFormat Format)
 {
@@ -38,6 +57,9 @@ static bool IsFormatSupported(const EPixelFormat Format)
 	case EPixelFormat::PF_DXT5:
 	case EPixelFormat::PF_B8G8R8A8:
 	case EPixelFormat::PF_FloatRGBA:
+	case EPixelFormat::PF_BC4:
+	case EPixelFormat::PF_BC5:
+	case EPixelFormat::PF_BC7:
 		fgcheck(GPixelFormats[Format].BlockSizeX <= MAX_BLOCK_SIDE);
 		return true;
 	default:
@@ -45,6 +67,18 @@ static bool IsFormatSupported(const EPixelFormat Format)
 	}
 }
 
+static bool IsOutputFormatSupported(const EPixelFormat Format)
+{
+	switch (Format) {
+	case EPixelFormat::PF_DXT1:
+	case EPixelFormat::PF_DXT5:
+	case EPixelFormat::PF_B8G8R8A8:
+		return true;
+	default:
+		return false;
+	}
+}
+
 static TextureParams ChooseCompatibleMips(const UTexture2D* Bot, const UTexture2D* Top)
 {
 	const EPixelFormat BotFmt = Bot->GetPixelFormat();
@@ -117,22 +151,155 @@ static TextureParams ChooseCompatibleMips(const UTexture2D* Bot, const UTexture2
 	return TextureParams();
 }
 
-static void DoApplyBinaryOp(UTexture2D* Out, UTexture2D* Bot, UTexture2D* Top, const TextureParams& Params, int32 OutMipIdx, TFunction<FPreciseBlock(FPreciseBlock, FPreciseBlock)> Func)
+/* Starts further down both mip chains, so that the output is at most MaxSize wide (0 for no limit) */
+static void LimitSize(TextureParams& Params, const int32 MaxSize)
+{
+	while (MaxSize > 0 and Params.SizeX > MaxSize) {
+		Params.SizeX >>= 1;
+		Params.SizeY >>= 1;
+		Params.MipIdxBot++;
+		Params.MipIdxTop++;
+	}
+}
+
+/* Same for a single texture, the first mip at most MaxSize wide */
+static int32 GetFirstMipWithin(const UTexture2D* Texture, const int32 MaxSize)
 {
-	BlockMapper BotBlock = BlockMapper(Bot, Params.MipIdxBot + OutMipIdx);
-	BlockMapper TopBlock = BlockMapper(Top, Params.MipIdxTop + OutMipIdx);
+	int32 MipIdx = 0;
+	while (MaxSize > 0 and MipIdx + 1 < Texture->GetNumMips() and Texture->GetPlatformData()->Mips[MipIdx].SizeX > MaxSize) {
+		MipIdx++;
+	}
+	return MipIdx;
+}
+
+enum class EBinaryOp : uint8
+{
+	/* Top over Bot, keeps Bot under fully transparent Top blocks and Top in fully opaque ones */
+	Over,
+	/* Bot through the steps of its mip jobs, which bring their own layers */
+	Compose,
+	Num,
+};
 
-	if (OutMipIdx > 0) {
+template<EBinaryOp Op>
+static FORCEINLINE void ApplyBinaryOp(FOverlayMip& Out, const FOverlayMip& Bot, const FOverlayMip& Top)
+{
+	static_assert(Op == EBinaryOp::Over, "Only over takes a single Top");
+	if constexpr (USE_PREMULTIPLIED_ALPHA) {
+		BlendKernels::OverPremultiplied(Out, Bot, Top);
+	} else {
+		BlendKernels::OverStraight(Out, Bot, Top);
+	}
+}
+
+enum class ECoverage : uint8
+{
+	Transparent,
+	Opaque,
+	Mixed,
+};
+
+/* A mip of Top, decoded (and premultiplied if needed) once and shared by every job using it */
+struct FDecodedMip
+{
+	FOverlayMip Mip;
+	/* Of the native bytes, stands in for them in texture cache keys */
+	uint64 Hash;
+	EPixelFormat Format;
+	TArray64<uint8> NativeBytes;
+	/* Alpha of every 4x4 block, row-major */
+	TArray<ECoverage> Coverage;
+};
+
+static TArray<ECoverage> ClassifyBlocks(const FOverlayMip& Mip)
+{
+	TArray<ECoverage> Coverage;
+	Coverage.Reserve((Mip.SizeX / MAX_BLOCK_SIDE) * (Mip.SizeY / MAX_BLOCK_SIDE));
+	for (int32 y = 0; y < Mip.SizeY; y += MAX_BLOCK_SIDE) {
+		for (int32 x = 0; x < Mip.SizeX; x += MAX_BLOCK_SIDE) {
+			bool bTransparent = true;
+			bool bOpaque = true;
+			for (int32 i = 0; i < MAX_BLOCK_PIXELS; i++) {
+				const FOverlayPrecision::Scalar Alpha = Mip.A()[(y + i / MAX_BLOCK_SIDE) * Mip.SizeX + x + i % MAX_BLOCK_SIDE];
+				bTransparent = bTransparent and Alpha == 0;
+				bOpaque = bOpaque and Alpha == FOverlayPrecision::ONE;
+			}
+			Coverage.Add(bTransparent ? ECoverage::Transparent : bOpaque ? ECoverage::Opaque : ECoverage::Mixed);
+		}
+	}
+	return Coverage;
+}
+
+/* Game thread only, Top is the same overlay for almost every texture */
+static TMap<TPair<TObjectKey<UTexture2D>, int32>, TSharedPtr<const FDecodedMip>> DecodedMips;
+
+static TSharedPtr<const FDecodedMip> GetDecodedMip(UTexture2D* Texture, const int32 MipIdx)
+{
+	const TPair<TObjectKey<UTexture2D>, int32> Key(Texture, MipIdx);
+	if (const TSharedPtr<const FDecodedMip>* Found = DecodedMips.Find(Key)) {
+		return *Found;
+	}
+	const BlockMapper Block(Texture, MipIdx, EMipAccess::ReadOnly);
+	const TSharedPtr<FDecodedMip> Decoded = MakeShared<FDecodedMip>();
+	Block.DecodeMip(Decoded->Mip);
+	if (USE_PREMULTIPLIED_ALPHA) {
+		BlendKernels::Premultiply(Decoded->Mip);
+	}
+	const TConstArrayView<uint8> Bytes = Block.GetNativeBytes();
+	Decoded->Hash = FXxHash64::HashBuffer(Bytes.GetData(), Bytes.Num()).Hash;
+	Decoded->Format = Block.GetPixelFormat();
+	Decoded->NativeBytes = Bytes;
+	Decoded->Coverage = ClassifyBlocks(Decoded->Mip);
+	DecodedMips.Add(Key, Decoded);
+	return Decoded;
+}
+
+/* A composition step for one mip, with its layer decoded and placed in pixels */
+struct FPlacedStep
+{
+	Th3Tex2DUtils::ECompositionOp Op;
+	TSharedPtr<const FDecodedMip> Layer;
+	FIntPoint Offset;
+	FIntPoint Size;
+	FLinearColor Color;
+	float Amount;
+};
+
+/* Everything one output mip needs, the mappers are created and destroyed on the game thread */
+/* Mips made by downsampling the previous one have no sources */
+struct FMipJob
+{
+	int32 OutMipIdx;
+	TUniquePtr<BlockMapper> BotBlock;
+	TSharedPtr<const FDecodedMip> TopMip;
+	TArray<FPlacedStep> Steps;
+	TUniquePtr<BlockMapper> OutBlock;
+};
+
+/* Source snapshots only, their contents decide whether anything needs to be generated */
+static FMipJob PrepareSourceMips(UTexture2D* Bot, UTexture2D* Top, const TextureParams& Params, int32 OutMipIdx)
+{
+	FMipJob Job;
+	Job.OutMipIdx = OutMipIdx;
+	Job.BotBlock = MakeUnique<BlockMapper>(Bot, Params.MipIdxBot + OutMipIdx, EMipAccess::ReadOnly);
+	Job.TopMip = GetDecodedMip(Top, Params.MipIdxTop + OutMipIdx);
+	return Job;
+}
+
+static void PrepareOutputMip(UTexture2D* Out, FMipJob& Job, const int32 SizeX, const int32 SizeY, const Th3Tex2DUtils::FOverlayOptions& Options)
+{
+	if (Job.OutMipIdx > 0) {
 		FTexture2DMipMap* Mip = new FTexture2DMipMap();
 		Out->GetPlatformData()->Mips.Add(Mip);
-		Mip->SizeX = Params.SizeX;
-		Mip->SizeY = Params.SizeY;
+		Mip->SizeX = SizeX;
+		Mip->SizeY = SizeY;
 		Mip->SizeZ = 1;
 
-		const FPixelFormatInfo& FmtInfo = GPixelFormats[OUTPUT_FORMAT];
+		const FPixelFormatInfo& FmtInfo = GPixelFormats[Options.OutputFormat];
 
-		const size_t NumBlocksX = Params.SizeX / FmtInfo.BlockSizeX;
-		const size_t NumBlocksY = Params.SizeY / FmtInfo.BlockSizeY;
+		/* Mips smaller than a block still take a whole one */
+		const size_t NumBlocksX = FMath::DivideAndRoundUp(Mip->SizeX, FmtInfo.BlockSizeX);
+		const size_t NumBlocksY = FMath::DivideAndRoundUp(Mip->SizeY, FmtInfo.BlockSizeY);
 		const size_t NumBytes = NumBlocksX * NumBlocksY * FmtInfo.BlockBytes;
 
 		Mip->BulkData.Lock(LOCK_READ_WRITE);
@@ -140,19 +307,146 @@ static void DoApplyBinaryOp(UTexture2D* Out, UTexture2D* Bot, UTexture2D* Top, c
 		Mip->BulkData.Unlock();
 	}
 
-	BlockMapper OutBlock = BlockMapper(Out, OutMipIdx);
+	Job.OutBlock = MakeUnique<BlockMapper>(Out, Job.OutMipIdx, EMipAccess::ReadWrite);
+	Job.OutBlock->SetEncodeOptions({ .bRefine = Options.bRefineEndpoints });
+}
+
+static void EncodeOutputMip(FMipJob& Job, const FOverlayMip& OutMip, TConstArrayView<bool> SkipBlocks = {})
+{
+	if (USE_PREMULTIPLIED_ALPHA) {
+		FOverlayMip Straight = OutMip;
+		BlendKernels::Unpremultiply(Straight);
+		Job.OutBlock->EncodeMip(Straight, SkipBlocks);
+	} else {
+		Job.OutBlock->EncodeMip(OutMip, SkipBlocks);
+	}
+}
+
+/*
+ * Under a fully transparent Top block the result is the Bot block, under
+ * a fully opaque one it is the Top block. Where those are stored in the
+ * output format already, their bytes are copied instead of encoded.
+ * Returns which blocks were copied, empty if none could be.
+ */
+static TArray<bool> CopyPassthroughBlocks(FMipJob& Job)
+{
+	TArray<bool> Copied;
+	const EPixelFormat Format = Job.OutBlock->GetPixelFormat();
+	const FPixelFormatInfo& FmtInfo = GPixelFormats[Format];
+	if (FmtInfo.BlockSizeX != MAX_BLOCK_SIDE or FmtInfo.BlockSizeY != MAX_BLOCK_SIDE) {
+		return Copied;
+	}
+	const bool bCopyBot = Job.BotBlock->GetPixelFormat() == Format;
+	const bool bCopyTop = Job.TopMip->Format == Format;
+	if (not bCopyBot and not bCopyTop) {
+		return Copied;
+	}
+
+	const TConstArrayView<uint8> BotBytes = Job.BotBlock->GetNativeBytes();
+	const TConstArrayView<uint8> TopBytes(Job.TopMip->NativeBytes);
+	const TArrayView<uint8> OutBytes = Job.OutBlock->GetMutableNativeBytes();
+	const TArray<ECoverage>& Coverage = Job.TopMip->Coverage;
+	fgcheck(OutBytes.Num() == Coverage.Num() * FmtInfo.BlockBytes);
 
-	UE_LOG(LogTh3Tex2DUtils, Verbose, TEXT("  - CREATING MIP %d"), OutMipIdx);
+	int32 NumCopied = 0;
+	Copied.SetNumZeroed(Coverage.Num());
+	for (int32 i = 0; i < Coverage.Num(); i++) {
+		const uint8* Src = nullptr;
+		if (Coverage[i] == ECoverage::Transparent and bCopyBot) {
+			Src = BotBytes.GetData();
+		} else if (Coverage[i] == ECoverage::Opaque and bCopyTop) {
+			Src = TopBytes.GetData();
+		} else {
+			continue;
+		}
+		const int32 Offset = i * FmtInfo.BlockBytes;
+		FMemory::Memcpy(OutBytes.GetData() + Offset, Src + Offset, FmtInfo.BlockBytes);
+		Copied[i] = true;
+		NumCopied++;
+	}
+	UE_LOG(LogTh3Tex2DUtils, Verbose, TEXT("  - COPIED %d OF %d BLOCKS"), NumCopied, Coverage.Num());
+	return Copied;
+}
 
-	for (size_t y = 0; y < Params.SizeY; y += MAX_BLOCK_SIDE) {
-		for (size_t x = 0; x < Params.SizeX; x += MAX_BLOCK_SIDE) {
-			OutBlock.WriteBlock(x, y, Invoke(Func, BotBlock.ReadBlock(x, y), TopBlock.ReadBlock(x, y)));
+/* All steps on the one planar mip, only layers that do not line up with it are resampled */
+static void ApplySteps(FOverlayMip& Mip, TConstArrayView<FPlacedStep> Steps)
+{
+	using namespace Th3Tex2DUtils;
+	FOverlayMip Placed, Blended;
+	for (const FPlacedStep& Step : Steps) {
+		const FOverlayMip* Layer = nullptr;
+		if (Step.Layer) {
+			Layer = &Step.Layer->Mip;
+			if (Step.Offset != FIntPoint::ZeroValue or Step.Size != FIntPoint(Mip.SizeX, Mip.SizeY) or not Layer->HasSameSize(Mip)) {
+				BlendKernels::Place(Placed, *Layer, Step.Offset.X, Step.Offset.Y, Step.Size.X, Step.Size.Y, Mip.SizeX, Mip.SizeY, USE_PREMULTIPLIED_ALPHA);
+				Layer = &Placed;
+			}
+		}
+		switch (Step.Op) {
+		case ECompositionOp::Over:
+			ApplyBinaryOp<EBinaryOp::Over>(Blended, Mip, *Layer);
+			Swap(Mip, Blended);
+			break;
+		case ECompositionOp::Multiply:
+			BlendKernels::Multiply(Mip, *Layer, USE_PREMULTIPLIED_ALPHA);
+			break;
+		case ECompositionOp::Tint:
+			BlendKernels::Tint(Mip, Step.Color, Step.Amount);
+			break;
+		case ECompositionOp::Desaturate:
+			BlendKernels::Desaturate(Mip, Step.Amount);
+			break;
 		}
 	}
+}
+
+/* Safe to run on any thread, leaves the composited mip in OutMip */
+template<EBinaryOp Op>
+static void ExecuteMipJob(FMipJob& Job, FOverlayMip& OutMip)
+{
+	UE_LOG(LogTh3Tex2DUtils, Verbose, TEXT("  - CREATING MIP %d"), Job.OutMipIdx);
+
+	FOverlayMip BotMip;
+	Job.BotBlock->DecodeMip(BotMip);
+	if (USE_PREMULTIPLIED_ALPHA) {
+		BlendKernels::Premultiply(BotMip);
+	}
+	if constexpr (Op == EBinaryOp::Over) {
+		ApplyBinaryOp<Op>(OutMip, BotMip, Job.TopMip->Mip);
+		EncodeOutputMip(Job, OutMip, CopyPassthroughBlocks(Job));
+	} else {
+		static_assert(Op == EBinaryOp::Compose, "Unhandled binary op");
+		OutMip = MoveTemp(BotMip);
+		ApplySteps(OutMip, Job.Steps);
+		EncodeOutputMip(Job, OutMip);
+	}
 
-	UE_LOG(LogTh3Tex2DUtils, Verbose, TEXT("  - DONE MIP %d"), OutMipIdx);
+	UE_LOG(LogTh3Tex2DUtils, Verbose, TEXT("  - DONE MIP %d"), Job.OutMipIdx);
 }
 
+/* Composites the first mip, every later one is a downsampled copy of the one before */
+template<EBinaryOp Op>
+static void ExecuteMipChain(TArrayView<FMipJob> Jobs)
+{
+	FOverlayMip Mips[2];
+	ExecuteMipJob<Op>(Jobs[0], Mips[0]);
+	for (int32 i = 1; i < Jobs.Num(); i++) {
+		const FOverlayMip& Prev = Mips[(i - 1) % 2];
+		FOverlayMip& Next = Mips[i % 2];
+		const BlockMapper& OutBlock = *Jobs[i].OutBlock;
+		BlendKernels::Downsample(Next, Prev, static_cast<int32>(OutBlock.GetSizeX()), static_cast<int32>(OutBlock.GetSizeY()), USE_PREMULTIPLIED_ALPHA);
+		EncodeOutputMip(Jobs[i], Next);
+	}
+}
+
+/* One instance per op, so that the op is known at compile time below the dispatch */
+using FMipChainExecutor = void (*)(TArrayView<FMipJob> Jobs);
+static constexpr FMipChainExecutor MIP_CHAIN_EXECUTORS[] = {
+	&ExecuteMipChain<EBinaryOp::Over>,
+	&ExecuteMipChain<EBinaryOp::Compose>,
+};
+static_assert(Th3Utilities::array_size(MIP_CHAIN_EXECUTORS) == static_cast<size_t>(EBinaryOp::Num), "Missing binary op executors");
+
 static bool IsPow2Square(const UTexture2D* Tex)
 {
 	if (Tex->GetSizeX() != Tex->GetSizeY()) {
@@ -186,15 +480,238 @@ static bool AreTexturesCompatible(UTexture2D* Bot, UTexture2D* Top)
 	return true;
 }
 
-static UTexture2D* ApplyBinaryOp(UTexture2D* Bot, UTexture2D* Top, TFunction<FPreciseBlock(FPreciseBlock, FPreciseBlock)> Func)
+/* Game thread: the mips PrepareBinaryOp is going to read, Top only if it was not decoded yet */
+static void PinSourceMips(FTextureResidency& Residency, UTexture2D* Bot, UTexture2D* Top, const Th3Tex2DUtils::FOverlayOptions& Options)
+{
+	if (not Bot or not Top or not IsPow2Square(Bot) or not IsPow2Square(Top)) {
+		return;
+	}
+	TextureParams Params = ChooseCompatibleMips(Bot, Top);
+	if (not Params.bSuccess) {
+		return;
+	}
+	LimitSize(Params, Options.MaxSize);
+	if (Params.MipIdxBot >= Bot->GetNumMips() or Params.MipIdxTop >= Top->GetNumMips()) {
+		return;
+	}
+	Residency.Add(Bot, Params.MipIdxBot);
+	if (not DecodedMips.Contains(TPair<TObjectKey<UTexture2D>, int32>(Top, Params.MipIdxTop))) {
+		Residency.Add(Top, Params.MipIdxTop);
+	}
+}
+
+/* Sources by object key, a new texture at the address of a collected one is not the same input */
+using FInputsKey = TTuple<TObjectKey<UTexture2D>, TObjectKey<UTexture2D>, uint32, int32>;
+
+/* One output texture, Out stays nullptr if the inputs cannot be combined */
+struct FTextureJob
+{
+	UTexture2D* Bot = nullptr;
+	UTexture2D* Out = nullptr;
+	EPixelFormat OutputFormat = EPixelFormat::PF_Unknown;
+	EBinaryOp Op = EBinaryOp::Over;
+	TArray<FMipJob> MipJobs;
+	/* What PrepareOutput needs, once the sources are hashed into CacheKey */
+	Th3Tex2DUtils::FOverlayOptions Options;
+	FIntPoint OutSize = FIntPoint::ZeroValue;
+	TOptional<FInputsKey> InputsKey;
+	TextureCache::FKey CacheKey;
+	bool bUseCache = false;
+	bool bLoadedFromCache = false;
+	/* Only the first mip job has sources, see ExecuteMipChain */
+	bool bDownsampleMips = false;
+	bool bDiscardCpuData = false;
+	FTextureAtlas* Atlas = nullptr;
+	/* Out was generated by an earlier job with the same inputs */
+	bool bShared = false;
+};
+
+/* Everything generated this session, by input textures and by content, game thread only */
+static TMap<FInputsKey, TWeakObjectPtr<UTexture2D>> GeneratedByInputs;
+static TMap<uint64, TWeakObjectPtr<UTexture2D>> GeneratedByContent;
+
+static FInputsKey MakeInputsKey(const UTexture2D* Bot, const UTexture2D* Top, const Th3Tex2DUtils::FOverlayOptions& Options)
+{
+	const uint32 Settings = static_cast<uint32>(Options.OutputFormat) | (Options.bRefineEndpoints ? 0x100 : 0x000) | (Options.bDownsampleMips ? 0x200 : 0x000);
+	return FInputsKey(Bot, Top, Settings, FMath::Max(Options.MaxSize, 0));
+}
+
+template<typename KeyType>
+static UTexture2D* FindGenerated(const TMap<KeyType, TWeakObjectPtr<UTexture2D>>& Generated, const KeyType& Key)
+{
+	const TWeakObjectPtr<UTexture2D>* Texture = Generated.Find(Key);
+	return Texture ? Texture->Get() : nullptr;
+}
+
+static FTextureJob& ShareGenerated(FTextureJob& Job, UTexture2D* Existing)
+{
+	UE_LOG(LogTh3Tex2DUtils, Log, TEXT(" -  Reusing %s"), *Existing->GetName());
+	Job.MipJobs.Empty();
+	Job.Out = Existing;
+	Job.OutputFormat = Existing->GetPixelFormat();
+	Job.bShared = true;
+	return Job;
+}
+
+/* Any thread, only reads the source snapshots */
+static TextureCache::FKey MakeCacheKey(const FTextureJob& Job)
+{
+	const Th3Tex2DUtils::FOverlayOptions& Options = Job.Options;
+	const FMipJob& FirstMip = Job.MipJobs[0];
+	FXxHash64Builder Builder;
+	const uint32 Settings[] = {
+		PIPELINE_VERSION,
+		static_cast<uint32>(Job.Op),
+		FirstMip.BotBlock->GetPixelFormat(),
+		FirstMip.TopMip ? FirstMip.TopMip->Format : EPixelFormat::PF_Unknown,
+		Options.OutputFormat,
+		Options.bRefineEndpoints,
+		Options.bDownsampleMips,
+		static_cast<uint32>(FMath::Max(Options.MaxSize, 0)),
+		USE_PREMULTIPLIED_ALPHA,
+		sizeof(FOverlayPrecision::Scalar),
+	};
+	Builder.Update(Settings, sizeof(Settings));
+	for (const FMipJob& MipJob : Job.MipJobs) {
+		if (not MipJob.BotBlock) {
+			continue;
+		}
+		const uint64 Sizes[] = { MipJob.BotBlock->GetSizeX(), MipJob.BotBlock->GetSizeY() };
+		const TConstArrayView<uint8> BotBytes = MipJob.BotBlock->GetNativeBytes();
+		Builder.Update(Sizes, sizeof(Sizes));
+		Builder.Update(BotBytes.GetData(), BotBytes.Num());
+		if (MipJob.TopMip) {
+			const int32 TopSizes[] = { MipJob.TopMip->Mip.SizeX, MipJob.TopMip->Mip.SizeY };
+			Builder.Update(TopSizes, sizeof(TopSizes));
+			Builder.Update(&MipJob.TopMip->Hash, sizeof(MipJob.TopMip->Hash));
+		}
+		for (const FPlacedStep& Step : MipJob.Steps) {
+			const int32 Placement[] = { static_cast<int32>(Step.Op), Step.Offset.X, Step.Offset.Y, Step.Size.X, Step.Size.Y };
+			const float Params[] = { Step.Color.R, Step.Color.G, Step.Color.B, Step.Amount };
+			const uint64 LayerHash = Step.Layer ? Step.Layer->Hash : 0;
+			Builder.Update(Placement, sizeof(Placement));
+			Builder.Update(Params, sizeof(Params));
+			Builder.Update(&LayerHash, sizeof(LayerHash));
+		}
+	}
+	return { .Hash = Builder.Finalize().Hash };
+}
+
+/* Any thread: fills the output mips from the texture cache, which leaves nothing to compute */
+static void LoadFromCache(FTextureJob& Job)
+{
+	if (not Job.bUseCache) {
+		return;
+	}
+	TArray<TArrayView<uint8>> Mips;
+	for (FMipJob& MipJob : Job.MipJobs) {
+		Mips.Add(MipJob.OutBlock->GetMutableNativeBytes());
+	}
+	Job.bLoadedFromCache = TextureCache::Load(Job.CacheKey, Job.OutputFormat, Mips);
+	if (Job.bLoadedFromCache) {
+		UE_LOG(LogTh3Tex2DUtils, Log, TEXT(" -  Loaded %s from the texture cache (%s)"), *Job.Out->GetName(), *Job.CacheKey.ToString());
+	}
+}
+
+/* Output mips are still locked here, entries are written straight from them */
+static void StoreInCache(const FTextureJob& Job)
+{
+	if (not Job.bUseCache or Job.bLoadedFromCache) {
+		return;
+	}
+	TArray<TConstArrayView<uint8>> Mips;
+	for (const FMipJob& MipJob : Job.MipJobs) {
+		Mips.Add(MipJob.OutBlock->GetNativeBytes());
+	}
+	TextureCache::Store(Job.CacheKey, Job.OutputFormat, Mips);
+}
+
+/* The sources are set up, but the output is not yet */
+static bool NeedsOutput(const FTextureJob& Job)
+{
+	return not Job.Out and not Job.MipJobs.IsEmpty();
+}
+
+/* Any thread: the cache key, the only pass over all of the source bytes */
+static void HashSources(FTextureJob& Job)
+{
+	if (NeedsOutput(Job)) {
+		Job.CacheKey = MakeCacheKey(Job);
+	}
+}
+
+/* Game thread: creates the output texture and sets up its mips */
+static void CreateOutput(FTextureJob& Job)
+{
+	const Th3Tex2DUtils::FOverlayOptions& Options = Job.Options;
+	const FString NewName = FString::Printf(TEXT("Compressed_%s"), *Job.Bot->GetName());
+	UTexture2D* Out = UTexture2D::CreateTransient(Job.OutSize.X, Job.OutSize.Y, Options.OutputFormat, FName(NewName));
+
+	LogTextureMipSizes(Out);
+
+	Job.Out = Out;
+	Job.OutputFormat = Options.OutputFormat;
+	Job.bDownsampleMips = Options.bDownsampleMips;
+	Job.bDiscardCpuData = Options.bDiscardCpuData;
+	for (FMipJob& MipJob : Job.MipJobs) {
+		PrepareOutputMip(Out, MipJob, MipJob.BotBlock->GetSizeX(), MipJob.BotBlock->GetSizeY(), Options);
+	}
+	if (Options.bDownsampleMips) {
+		/* The whole chain down to 1x1, so that small icons can use small mips */
+		for (int32 SizeX = Job.OutSize.X / 2, SizeY = Job.OutSize.Y / 2; SizeX >= 1 or SizeY >= 1; SizeX /= 2, SizeY /= 2) {
+			FMipJob& MipJob = Job.MipJobs.AddDefaulted_GetRef();
+			MipJob.OutMipIdx = Job.MipJobs.Num() - 1;
+			PrepareOutputMip(Out, MipJob, FMath::Max(SizeX, 1), FMath::Max(SizeY, 1), Options);
+		}
+	}
+
+	/* Registered right away, so that later jobs in the same batch share it too */
+	GeneratedByContent.Add(Job.CacheKey.Hash, Out);
+	/* Looked up by the worker, together with the blending */
+	Job.bUseCache = Options.bUseCache;
+}
+
+/* Game thread: after HashSources, shares or creates the output texture */
+static void PrepareOutput(FTextureJob& Job)
+{
+	if (not NeedsOutput(Job)) {
+		return;
+	}
+	/* Other textures, but with the same contents (e.g. a copy of a vanilla icon) */
+	if (UTexture2D* Existing = FindGenerated(GeneratedByContent, Job.CacheKey.Hash)) {
+		ShareGenerated(Job, Existing);
+	} else {
+		CreateOutput(Job);
+	}
+	if (Job.InputsKey) {
+		GeneratedByInputs.Add(*Job.InputsKey, Job.Out);
+	}
+}
+
+/* Game thread: hashes in parallel, then creates the outputs in order so that later jobs share earlier ones */
+static void PrepareOutputs(TArrayView<FTextureJob> Jobs)
+{
+	ParallelFor(Jobs.Num(), [&Jobs](const int32 Idx) { HashSources(Jobs[Idx]); });
+	for (FTextureJob& Job : Jobs) {
+		PrepareOutput(Job);
+	}
+}
+
+/* Game thread: validates the inputs and snapshots the sources, PrepareOutputs does the rest */
+static FTextureJob PrepareBinaryOp(UTexture2D* Bot, UTexture2D* Top, Th3Tex2DUtils::FOverlayOptions Options, const EBinaryOp Op)
 {
+	FTextureJob Job;
+	Job.Bot = Bot;
+	Job.Op = Op;
+	Job.Atlas = Options.Atlas;
+
 	if (not Bot) {
 		UE_LOG(LogTh3Tex2DUtils, Error, TEXT("Got a nullptr Bot"));
-		return Bot;
+		return Job;
 	}
 	if (not Top) {
 		UE_LOG(LogTh3Tex2DUtils, Error, TEXT("Got a nullptr Top"));
-		return Bot;
+		return Job;
 	}
 	UE_LOG(LogTh3Tex2DUtils, Log, TEXT("Processing %s..."), *Bot->GetName());
 
@@ -203,15 +720,16 @@ static UTexture2D* ApplyBinaryOp(UTexture2D* Bot, UTexture2D* Top, TFunction<FPr
 
 	if (not AreTexturesCompatible(Bot, Top)) {
 		UE_LOG(LogTh3Tex2DUtils, Error, TEXT("CANNOT PROCESS: INCOMPATIBLE"));
-		return Bot;
+		return Job;
 	}
 
 	TextureParams Params = ChooseCompatibleMips(Bot, Top);
 
 	if (not Params.bSuccess) {
 		UE_LOG(LogTh3Tex2DUtils, Error, TEXT("Could not generate new Texture, using default"));
-		return Bot;
+		return Job;
 	}
+	LimitSize(Params, Options.MaxSize);
 
 	UE_LOG(LogTh3Tex2DUtils, Verbose, TEXT("Bot Pending Init or Streaming is %d"), Bot->HasPendingInitOrStreaming());
 	UE_LOG(LogTh3Tex2DUtils, Verbose, TEXT("Top Pending Init or Streaming is %d"), Top->HasPendingInitOrStreaming());
@@ -219,11 +737,18 @@ static UTexture2D* ApplyBinaryOp(UTexture2D* Bot, UTexture2D* Top, TFunction<FPr
 	UE_LOG(LogTh3Tex2DUtils, Verbose, TEXT("Bot Fully Streamed In is %d"), Bot->IsFullyStreamedIn());
 	UE_LOG(LogTh3Tex2DUtils, Verbose, TEXT("Top Fully Streamed In is %d"), Top->IsFullyStreamedIn());
 
-	const FString NewName = FString::Printf(TEXT("Compressed_%s"), *Bot->GetName());
-	UTexture2D* Out = UTexture2D::CreateTransient(Params.SizeX, Params.SizeY, OUTPUT_FORMAT, FName(NewName));
+	if (not IsOutputFormatSupported(Options.OutputFormat)) {
+		UE_LOG(LogTh3Tex2DUtils, Error, TEXT("Cannot write %s, using %s instead"), GetPixelFormatString(Options.OutputFormat), GetPixelFormatString(EPixelFormat::PF_B8G8R8A8));
+		Options.OutputFormat = EPixelFormat::PF_B8G8R8A8;
+	}
 
-	LogTextureMipSizes(Out);
+	/* Same textures as before, not even worth looking at their contents */
+	const FInputsKey InputsKey = MakeInputsKey(Bot, Top, Options);
+	if (UTexture2D* Existing = FindGenerated(GeneratedByInputs, InputsKey)) {
+		return ShareGenerated(Job, Existing);
+	}
 
+	const FIntPoint OutSize(Params.SizeX, Params.SizeY);
 	const int32 NumMipsBot = Bot->GetNumMips();
 	const int32 NumMipsTop = Top->GetNumMips();
 
@@ -232,37 +757,453 @@ static UTexture2D* ApplyBinaryOp(UTexture2D* Bot, UTexture2D* Top, TFunction<FPr
 		if (Params.SizeX < 4) {
 			break;
 		}
+		if (Options.bDownsampleMips and MipIdx > 0) {
+			break;
+		}
 		if (Params.MipIdxBot + MipIdx >= NumMipsBot) {
 			break;
 		}
 		if (Params.MipIdxTop + MipIdx >= NumMipsTop) {
 			break;
 		}
-		DoApplyBinaryOp(Out, Bot, Top, Params, MipIdx, Func);
+		Job.MipJobs.Add(PrepareSourceMips(Bot, Top, Params, MipIdx));
 		MipIdx++;
 		Params.SizeX >>= 1;
 		Params.SizeY >>= 1;
 	}
+	if (Job.MipJobs.IsEmpty()) {
+		UE_LOG(LogTh3Tex2DUtils, Error, TEXT("No mips left to generate, using default"));
+		return Job;
+	}
+
+	Job.Options = Options;
+	Job.OutSize = OutSize;
+	Job.InputsKey = InputsKey;
+	return Job;
+}
+
+static bool NeedsLayer(const Th3Tex2DUtils::ECompositionOp Op)
+{
+	return Op == Th3Tex2DUtils::ECompositionOp::Over or Op == Th3Tex2DUtils::ECompositionOp::Multiply;
+}
+
+/* Steps whose layer cannot be used are left out, the rest of the composition still runs */
+static TArray<Th3Tex2DUtils::FCompositionStep> GetValidSteps(const Th3Tex2DUtils::FComposition& Composition)
+{
+	TArray<Th3Tex2DUtils::FCompositionStep> Steps;
+	for (int32 i = 0; i < Composition.Steps.Num(); i++) {
+		const Th3Tex2DUtils::FCompositionStep& Step = Composition.Steps[i];
+		if (NeedsLayer(Step.Op)) {
+			if (not Step.Layer or not IsPow2Square(Step.Layer) or not IsFormatSupported(Step.Layer->GetPixelFormat())) {
+				UE_LOG(LogTh3Tex2DUtils, Error, TEXT("Skipping step %d, cannot use layer %s"), i, *GetNameSafe(Step.Layer));
+				continue;
+			}
+			if (Step.Scale <= 0) {
+				UE_LOG(LogTh3Tex2DUtils, Error, TEXT("Skipping step %d, scale %f is not positive"), i, Step.Scale);
+				continue;
+			}
+		}
+		Steps.Add(Step);
+	}
+	return Steps;
+}
+
+/* Smallest mip of Layer that is still at least Size wide, or the largest one there is */
+static int32 ChooseLayerMip(const UTexture2D* Layer, const int32 Size)
+{
+	int32 Best = 0;
+	for (int32 MipIdx = 1; MipIdx < Layer->GetNumMips(); MipIdx++) {
+		const int32 MipSize = Layer->GetPlatformData()->Mips[MipIdx].SizeX;
+		if (MipSize < Size or MipSize < MAX_BLOCK_SIDE) {
+			break;
+		}
+		Best = MipIdx;
+	}
+	return Best;
+}
+
+/* Game thread: like PrepareBinaryOp, with every step placed for every mip of Base */
+static FTextureJob PrepareComposition(UTexture2D* Base, TConstArrayView<Th3Tex2DUtils::FCompositionStep> Steps, Th3Tex2DUtils::FOverlayOptions Options)
+{
+	FTextureJob Job;
+	Job.Bot = Base;
+	Job.Op = EBinaryOp::Compose;
+	Job.Atlas = Options.Atlas;
+
+	if (not Base) {
+		UE_LOG(LogTh3Tex2DUtils, Error, TEXT("Got a nullptr Base"));
+		return Job;
+	}
+	UE_LOG(LogTh3Tex2DUtils, Log, TEXT("Composing %s with %d steps..."), *Base->GetName(), Steps.Num());
+	if (not IsPow2Square(Base) or not IsFormatSupported(Base->GetPixelFormat())) {
+		UE_LOG(LogTh3Tex2DUtils, Error, TEXT("CANNOT PROCESS: BASE IS NOT A SUPPORTED POW2 SQUARE"));
+		return Job;
+	}
+	if (not IsOutputFormatSupported(Options.OutputFormat)) {
+		UE_LOG(LogTh3Tex2DUtils, Error, TEXT("Cannot write %s, using %s instead"), GetPixelFormatString(Options.OutputFormat), GetPixelFormatString(EPixelFormat::PF_B8G8R8A8));
+		Options.OutputFormat = EPixelFormat::PF_B8G8R8A8;
+	}
+
+	const int32 FirstMipIdx = GetFirstMipWithin(Base, Options.MaxSize);
+	for (int32 MipIdx = FirstMipIdx; MipIdx < Base->GetNumMips(); MipIdx++) {
+		const FTexture2DMipMap& Mip = Base->GetPlatformData()->Mips[MipIdx];
+		if (Mip.SizeX < 4) {
+			break;
+		}
+		if (Options.bDownsampleMips and MipIdx > FirstMipIdx) {
+			break;
+		}
+		FMipJob& MipJob = Job.MipJobs.AddDefaulted_GetRef();
+		MipJob.OutMipIdx = MipIdx - FirstMipIdx;
+		MipJob.BotBlock = MakeUnique<BlockMapper>(Base, MipIdx, EMipAccess::ReadOnly);
+		for (const Th3Tex2DUtils::FCompositionStep& Step : Steps) {
+			FPlacedStep& Placed = MipJob.Steps.AddDefaulted_GetRef();
+			Placed.Op = Step.Op;
+			Placed.Color = Step.Color;
+			Placed.Amount = FMath::Clamp(Step.Amount, 0.0f, 1.0f);
+			if (NeedsLayer(Step.Op)) {
+				const int32 Size = FMath::Max(1, FMath::RoundToInt(Step.Scale * Mip.SizeX));
+				Placed.Offset = FIntPoint(FMath::RoundToInt(Step.Offset.X * Mip.SizeX), FMath::RoundToInt(Step.Offset.Y * Mip.SizeY));
+				Placed.Size = FIntPoint(Size, Size);
+				Placed.Layer = GetDecodedMip(Step.Layer, ChooseLayerMip(Step.Layer, Size));
+			}
+		}
+	}
+	if (Job.MipJobs.IsEmpty()) {
+		UE_LOG(LogTh3Tex2DUtils, Error, TEXT("Could not generate new Texture, using default"));
+		return Job;
+	}
+
+	const FTexture2DMipMap& FirstMip = Base->GetPlatformData()->Mips[FirstMipIdx];
+	Job.Options = Options;
+	Job.OutSize = FIntPoint(FirstMip.SizeX, FirstMip.SizeY);
+	return Job;
+}
+
+/* Game thread: releases the mappers and returns the result, which is Bot if nothing was generated. New textures go into Uploads */
+static UTexture2D* FinalizeBinaryOp(FTextureJob& Job, TArray<UTexture2D*>& Uploads)
+{
+	if (not Job.Out) {
+		return Job.Bot;
+	}
+	if (Job.bShared) {
+		/* The job that generated it may not have asked for an atlas, Add() returns the slot if it did */
+		if (Job.Atlas) {
+			Job.Atlas->Add(Job.Out);
+		}
+		return Job.Out;
+	}
+
+	/* Unlocks the output mips */
+	Job.MipJobs.Empty();
 
 	UE_LOG(LogTh3Tex2DUtils, Verbose, TEXT("Generated New Texture"));
 
-	LogTextureMipSizes(Out);
+	LogTextureMipSizes(Job.Out);
+
+	if (Job.Atlas) {
+		Job.Atlas->Add(Job.Out);
+	}
+
+	/* Dropped once uploaded, everything needing the bytes (like the texture cache) is done by now */
+	if (Job.bDiscardCpuData) {
+		for (FTexture2DMipMap& Mip : Job.Out->GetPlatformData()->Mips) {
+			Mip.BulkData.SetBulkDataFlags(BULKDATA_SingleUse);
+		}
+	}
+
+	Uploads.Add(Job.Out);
 
-	Out->UpdateResource();
+	return Job.Out;
+}
 
-	return Out;
+/*
+ * Game thread: creates the render resources of textures that are done on
+ * the CPU, all in one go instead of in between generating the next ones.
+ * Only queues work for the render thread, nothing here waits for it.
+ */
+static void UploadTextures(TConstArrayView<UTexture2D*> Textures)
+{
+	if (Textures.IsEmpty()) {
+		return;
+	}
+	const double Begin = FPlatformTime::Seconds();
+	for (UTexture2D* Texture : Textures) {
+		Texture->UpdateResource();
+	}
+	const double End = FPlatformTime::Seconds();
+	UE_LOG(LogTh3Tex2DUtils, Verbose, TEXT("Took %f ms to queue %d uploads"), (End - Begin) * 1000, Textures.Num());
 }
 
-static FPreciseBlock OverlayBlocks(const FPreciseBlock& Bot, const FPreciseBlock& Top)
+/* Game thread: like FinalizeBinaryOp, for a single texture */
+static UTexture2D* FinalizeAndUpload(FTextureJob& Job)
 {
-	FPreciseBlock Out;
-	Th3Utilities::StaticFor<0, MAX_BLOCK_PIXELS>()([&](size_t i) {
-		Out.Data[i] = FPreciseColor::Over(Bot.Data[i], Top.Data[i]);
+	TArray<UTexture2D*> Uploads;
+	UTexture2D* Result = FinalizeBinaryOp(Job, Uploads);
+	UploadTextures(Uploads);
+	return Result;
+}
+
+/* Any thread: every mip of every texture is independent, and each one also spreads its block rows */
+static void ExecuteBinaryOps(TArrayView<FTextureJob> Jobs)
+{
+	ParallelFor(Jobs.Num(), [&Jobs](const int32 Idx) {
+		LoadFromCache(Jobs[Idx]);
+	});
+
+	/* A downsampled chain is one item, each mip needs the one before */
+	TArray<TPair<TArrayView<FMipJob>, EBinaryOp>> Items;
+	for (FTextureJob& Job : Jobs) {
+		if (Job.bLoadedFromCache) {
+			continue;
+		}
+		if (Job.bDownsampleMips and not Job.MipJobs.IsEmpty()) {
+			Items.Emplace(Job.MipJobs, Job.Op);
+			continue;
+		}
+		for (FMipJob& MipJob : Job.MipJobs) {
+			Items.Emplace(MakeArrayView(&MipJob, 1), Job.Op);
+		}
+	}
+	ParallelFor(Items.Num(), [&Items](const int32 Idx) {
+		Invoke(MIP_CHAIN_EXECUTORS[static_cast<size_t>(Items[Idx].Value)], Items[Idx].Key);
+	});
+	ParallelFor(Jobs.Num(), [&Jobs](const int32 Idx) {
+		StoreInCache(Jobs[Idx]);
 	});
-	return Out;
 }
 
-UTexture2D* Th3Tex2DUtils::OverlayTextures(UTexture2D* Bot, UTexture2D* Top)
+UTexture2D* Th3Tex2DUtils::ComposeTexture(UTexture2D* Base, const FComposition& Composition, const FOverlayOptions& Options)
+{
+	fgcheck(IsInGameThread());
+	const TArray<FCompositionStep> Steps = GetValidSteps(Composition);
+
+	FTextureResidency Residency;
+	if (Base) {
+		Residency.Add(Base, GetFirstMipWithin(Base, Options.MaxSize));
+	}
+	for (const FCompositionStep& Step : Steps) {
+		if (NeedsLayer(Step.Op)) {
+			Residency.Add(Step.Layer, 0);
+		}
+	}
+	Residency.Wait();
+	TArray<FTextureJob> Jobs;
+	Jobs.Add(PrepareComposition(Base, Steps, Options));
+	Residency.Release();
+	PrepareOutputs(Jobs);
+	ExecuteBinaryOps(Jobs);
+	return FinalizeAndUpload(Jobs[0]);
+}
+
+void Th3Tex2DUtils::PrepareOverlay(UTexture2D* Top)
+{
+	fgcheck(IsInGameThread());
+	if (not Top or not IsPow2Square(Top) or not IsFormatSupported(Top->GetPixelFormat())) {
+		UE_LOG(LogTh3Tex2DUtils, Error, TEXT("Cannot prepare overlay %s"), *GetNameSafe(Top));
+		return;
+	}
+	const double Begin = FPlatformTime::Seconds();
+	FTextureResidency Residency;
+	Residency.Add(Top, 0);
+	Residency.Wait();
+	for (int32 MipIdx = 0; MipIdx < Top->GetNumMips() and Top->GetPlatformData()->Mips[MipIdx].SizeX >= 4; MipIdx++) {
+		GetDecodedMip(Top, MipIdx);
+	}
+	const double End = FPlatformTime::Seconds();
+	UE_LOG(LogTh3Tex2DUtils, Log, TEXT("Took %f ms to decode overlay %s"), (End - Begin) * 1000, *Top->GetName());
+}
+
+void Th3Tex2DUtils::ReleaseOverlay(const UTexture2D* Top)
+{
+	fgcheck(IsInGameThread());
+	const TObjectKey<UTexture2D> Key(Top);
+	for (auto It = DecodedMips.CreateIterator(); It; ++It) {
+		if (It.Key().Key == Key) {
+			It.RemoveCurrent();
+		}
+	}
+}
+
+UTexture2D* Th3Tex2DUtils::OverlayTextures(UTexture2D* Bot, UTexture2D* Top, const FOverlayOptions& Options)
+{
+	FTextureResidency Residency;
+	PinSourceMips(Residency, Bot, Top, Options);
+	Residency.Wait();
+	TArray<FTextureJob> Jobs;
+	Jobs.Add(PrepareBinaryOp(Bot, Top, Options, EBinaryOp::Over));
+	Residency.Release();
+	PrepareOutputs(Jobs);
+	ExecuteBinaryOps(Jobs);
+	return FinalizeAndUpload(Jobs[0]);
+}
+
+void Th3Tex2DUtils::FOverlayBatch::Add(UTexture2D* Bot, UTexture2D* Top, const FOverlayOptions& Options, FOnOverlayDone OnDone)
 {
-	return ApplyBinaryOp(Bot, Top, &OverlayBlocks);
+	Requests.Add({ Bot, Top, Options, MoveTemp(OnDone) });
+}
+
+void Th3Tex2DUtils::FOverlayBatch::Run()
+{
+	fgcheck(IsInGameThread());
+	if (Requests.IsEmpty()) {
+		return;
+	}
+	UE_LOG(LogTh3Tex2DUtils, Log, TEXT("Compositing a batch of %d textures"), Requests.Num());
+	const double Begin = FPlatformTime::Seconds();
+
+	/* Stream in every source at once, they are only needed until their snapshots are taken */
+	FTextureResidency Residency;
+	for (const FOverlayRequest& Request : Requests) {
+		PinSourceMips(Residency, Request.Bot, Request.Top, Request.Options);
+	}
+	Residency.Wait();
+
+	TArray<FTextureJob> Jobs;
+	Jobs.Reserve(Requests.Num());
+	for (const FOverlayRequest& Request : Requests) {
+		Jobs.Add(PrepareBinaryOp(Request.Bot, Request.Top, Request.Options, EBinaryOp::Over));
+	}
+	Residency.Release();
+
+	PrepareOutputs(Jobs);
+	ExecuteBinaryOps(Jobs);
+
+	/* Every texture is done on the CPU before any of them goes to the render thread */
+	TArray<UTexture2D*> Results, Uploads;
+	Results.Reserve(Jobs.Num());
+	Uploads.Reserve(Jobs.Num());
+	for (FTextureJob& Job : Jobs) {
+		Results.Add(FinalizeBinaryOp(Job, Uploads));
+	}
+	UploadTextures(Uploads);
+
+	/* Take the requests first, callbacks may queue more work for the next batch */
+	TArray<FOverlayRequest> Done = MoveTemp(Requests);
+	Requests.Reset();
+	for (int32 i = 0; i < Done.Num(); i++) {
+		Invoke(Done[i].OnDone, Results[i]);
+	}
+
+	const double End = FPlatformTime::Seconds();
+	UE_LOG(LogTh3Tex2DUtils, Log, TEXT("Took %f ms to composite %d textures"), (End - Begin) * 1000, Done.Num());
+}
+
+struct Th3Tex2DUtils::FOverlayQueue::FInFlight
+{
+	FOverlayRequest Request;
+	FTextureJob Job;
+	UE::Tasks::FTask Task;
+};
+
+/* Out of line, FInFlight is only complete in here */
+Th3Tex2DUtils::FOverlayQueue::FOverlayQueue() = default;
+
+Th3Tex2DUtils::FOverlayQueue::~FOverlayQueue()
+{
+	for (const TUniquePtr<FInFlight>& Item : InFlight) {
+		Item->Task.Wait();
+	}
+}
+
+void Th3Tex2DUtils::FOverlayQueue::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	for (FOverlayRequest& Request : Pending) {
+		Collector.AddReferencedObject(Request.Bot);
+		Collector.AddReferencedObject(Request.Top);
+	}
+	for (const TUniquePtr<FInFlight>& Item : InFlight) {
+		Collector.AddReferencedObject(Item->Request.Bot);
+		Collector.AddReferencedObject(Item->Request.Top);
+		Collector.AddReferencedObject(Item->Job.Bot);
+		Collector.AddReferencedObject(Item->Job.Out);
+	}
+}
+
+void Th3Tex2DUtils::FOverlayQueue::Add(UTexture2D* Bot, UTexture2D* Top, const FOverlayOptions& Options, FOnOverlayDone OnDone)
+{
+	Pending.Add({ Bot, Top, Options, MoveTemp(OnDone) });
+}
+
+void Th3Tex2DUtils::FOverlayQueue::Tick(const double BudgetSeconds)
+{
+	fgcheck(IsInGameThread());
+	const double Deadline = FPlatformTime::Seconds() + BudgetSeconds;
+
+	/* Uploaded together at the end of the tick, callbacks only run after that */
+	TArray<TPair<FOnOverlayDone, UTexture2D*>> Done;
+	TArray<UTexture2D*> Uploads;
+
+	/* Shared outputs are handed out only once the item generating them is done */
+	const auto IsBeingGenerated = [this](const FTextureJob& Job) {
+		return Job.bShared and InFlight.ContainsByPredicate([&Job](const TUniquePtr<FInFlight>& Other) {
+			return Other->Job.Out == Job.Out and not Other->Job.bShared;
+		});
+	};
+
+	/* Hand out finished textures first, those are what someone is waiting for */
+	for (int32 i = 0; i < InFlight.Num() and FPlatformTime::Seconds() < Deadline;) {
+		FTextureJob& Job = InFlight[i]->Job;
+		if (not InFlight[i]->Task.IsCompleted() or IsBeingGenerated(Job)) {
+			i++;
+			continue;
+		}
+		if (NeedsOutput(Job)) {
+			/* Hashed on a worker, the output is created here and filled on a worker again */
+			PrepareOutput(Job);
+			if (not Job.bShared) {
+				InFlight[i]->Task = UE::Tasks::Launch(UE_SOURCE_LOCATION, [&Job]() {
+					ExecuteBinaryOps(MakeArrayView(&Job, 1));
+				});
+			}
+			continue;
+		}
+		const TUniquePtr<FInFlight> Item = MoveTemp(InFlight[i]);
+		InFlight.RemoveAt(i);
+		UTexture2D* Result = FinalizeBinaryOp(Item->Job, Uploads);
+		Done.Emplace(MoveTemp(Item->Request.OnDone), Result);
+	}
+
+	/* Stream in the sources of the next few requests together, without waiting for them */
+	const int32 MaxInFlight = FMath::Max(1, FTaskGraphInterface::Get().GetNumWorkerThreads());
+	if (NumStaged == 0 and not Pending.IsEmpty()) {
+		NumStaged = FMath::Min(Pending.Num(), MaxInFlight);
+		for (int32 i = 0; i < NumStaged; i++) {
+			PinSourceMips(Residency, Pending[i].Bot, Pending[i].Top, Pending[i].Options);
+		}
+	}
+	const bool bSourcesReady = Residency.IsReady();
+
+	/* Keep all workers busy, but do not run ahead of the budget */
+	while (bSourcesReady and NumStaged > 0 and InFlight.Num() < MaxInFlight and FPlatformTime::Seconds() < Deadline) {
+		TUniquePtr<FInFlight> Item = MakeUnique<FInFlight>();
+		Item->Request = MoveTemp(Pending[0]);
+		Pending.RemoveAt(0);
+		NumStaged--;
+		Item->Job = PrepareBinaryOp(Item->Request.Bot, Item->Request.Top, Item->Request.Options, EBinaryOp::Over);
+		if (NeedsOutput(Item->Job)) {
+			/* The item outlives the task, it is only removed once the task is done */
+			FTextureJob* Job = &Item->Job;
+			Item->Task = UE::Tasks::Launch(UE_SOURCE_LOCATION, [Job]() {
+				HashSources(*Job);
+			});
+			InFlight.Add(MoveTemp(Item));
+			continue;
+		}
+		if (IsBeingGenerated(Item->Job)) {
+			/* Without a task, it is picked up as soon as the other item is done */
+			InFlight.Add(MoveTemp(Item));
+			continue;
+		}
+		UTexture2D* Result = FinalizeBinaryOp(Item->Job, Uploads);
+		Done.Emplace(MoveTemp(Item->Request.OnDone), Result);
+	}
+	if (bSourcesReady and NumStaged == 0) {
+		Residency.Release();
+	}
+
+	UploadTextures(Uploads);
+	for (TPair<FOnOverlayDone, UTexture2D*>& Result : Done) {
+		Invoke(Result.Key, Result.Value);
+	}
 }
@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#pragma once
+
+#include "DXTDecoder.h"
+
+#include <CoreMinimal.h>
+
+/* Same layout as the alpha half of a DXT5 block */
+struct FBC4
+{
+	uint8 Red[8];
+};
+
+struct FBC5
+{
+	FBC4 Red;
+	FBC4 Green;
+};
+
+struct FBC7
+{
+	uint64 Lo;
+	uint64 Hi;
+};
+
+static_assert(sizeof(FBC4) == 8, "BC4 block size mismatch");
+static_assert(sizeof(FBC5) == 16, "BC5 block size mismatch");
+static_assert(sizeof(FBC7) == 16, "BC7 block size mismatch");
+
+/*
+ * Decoders for the newer block formats, into the same planar blocks as
+ * DXTDecoder. BC4 and BC5 reuse the DXT5 alpha palette, and decode like
+ * the hardware does: missing channels are 0, alpha is 1. BC7 covers all
+ * eight modes; reserved mode bits decode to transparent black.
+ */
+namespace BCDecoder
+{
+	void DecodeBC4(FPlanarBlock& OutBlock, const FBC4& InBlock);
+	void DecodeBC5(FPlanarBlock& OutBlock, const FBC5& InBlock);
+	void DecodeBC7(FPlanarBlock& OutBlock, const FBC7& InBlock);
+};
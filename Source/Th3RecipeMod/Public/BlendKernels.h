@@ -0,0 +1,271 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#pragma once
+
+#include "PlanarMip.h"
+#include "Th3Simd.h"
+
+#include <CoreMinimal.h>
+
+/*
+ * Porter-Duff "over" on whole planar mips. Both pipelines agree with
+ * FPreciseColor::Over to within OVER_TOLERANCE per channel with float
+ * precision, which is far below one step of an 8-bit output channel.
+ * Fixed point stays within half a step (FIXED16_OVER_TOLERANCE), after
+ * Unpremultiply only for colors weighted by their coverage.
+ *
+ * The generic templates work with any precision policy, float planes
+ * additionally get SSE2/AVX2 versions through plain overloads.
+ */
+namespace BlendKernels
+{
+	static constexpr float OVER_TOLERANCE = 1e-5f;
+	static constexpr float FIXED16_OVER_TOLERANCE = 0.5f / 255;
+
+	template<typename PolicyT>
+	struct TOverPlanes
+	{
+		using Scalar = typename PolicyT::Scalar;
+
+		const Scalar* RESTRICT Bot[4];
+		const Scalar* RESTRICT Top[4];
+		Scalar* RESTRICT Out[4];
+		int32 Num;
+
+		TOverPlanes(TPlanarMip<PolicyT>& OutMip, const TPlanarMip<PolicyT>& BotMip, const TPlanarMip<PolicyT>& TopMip)
+		{
+			fgcheck(BotMip.HasSameSize(TopMip));
+			OutMip.Init(BotMip.SizeX, BotMip.SizeY);
+			for (int32 c = 0; c < 4; c++) {
+				Bot[c] = BotMip.Plane(c);
+				Top[c] = TopMip.Plane(c);
+				Out[c] = OutMip.Plane(c);
+			}
+			Num = OutMip.Num();
+		}
+	};
+
+	template<typename PolicyT>
+	FORCEINLINE void OverStraightPixels(const TOverPlanes<PolicyT>& P, int32 Begin, const int32 End)
+	{
+		using Scalar = typename PolicyT::Scalar;
+		using Wide = typename PolicyT::Wide;
+		for (int32 i = Begin; i < End; i++) {
+			const Scalar TopCoef = P.Top[3][i];
+			const Scalar BotCoef = PolicyT::Mul(P.Bot[3][i], static_cast<Scalar>(PolicyT::ONE - TopCoef));
+			const Scalar Alpha = static_cast<Scalar>(TopCoef + BotCoef);
+			if (not PolicyT::IsVisible(Alpha)) {
+				for (int32 c = 0; c < 4; c++) {
+					P.Out[c][i] = Scalar(0);
+				}
+				continue;
+			}
+			for (int32 c = 0; c < 3; c++) {
+				const Wide Sum = static_cast<Wide>(P.Top[c][i]) * TopCoef + static_cast<Wide>(P.Bot[c][i]) * BotCoef;
+				P.Out[c][i] = PolicyT::Div(Sum, Alpha);
+			}
+			P.Out[3][i] = Alpha;
+		}
+	}
+
+	template<typename PolicyT>
+	FORCEINLINE void OverPremultipliedPixels(const TOverPlanes<PolicyT>& P, int32 Begin, const int32 End)
+	{
+		using Scalar = typename PolicyT::Scalar;
+		for (int32 i = Begin; i < End; i++) {
+			const Scalar BotCoef = static_cast<Scalar>(PolicyT::ONE - P.Top[3][i]);
+			for (int32 c = 0; c < 4; c++) {
+				P.Out[c][i] = static_cast<Scalar>(P.Top[c][i] + PolicyT::Mul(P.Bot[c][i], BotCoef));
+			}
+		}
+	}
+
+	/* Straight alpha, one division per pixel */
+	template<typename PolicyT>
+	void OverStraight(TPlanarMip<PolicyT>& Out, const TPlanarMip<PolicyT>& Bot, const TPlanarMip<PolicyT>& Top)
+	{
+		const TOverPlanes<PolicyT> P(Out, Bot, Top);
+		OverStraightPixels(P, 0, P.Num);
+	}
+	void OverStraight(FPlanarMip& Out, const FPlanarMip& Bot, const FPlanarMip& Top);
+	void OverStraightScalar(FPlanarMip& Out, const FPlanarMip& Bot, const FPlanarMip& Top);
+
+	/* Premultiplied alpha, no division, inputs must have gone through Premultiply */
+	template<typename PolicyT>
+	void OverPremultiplied(TPlanarMip<PolicyT>& Out, const TPlanarMip<PolicyT>& Bot, const TPlanarMip<PolicyT>& Top)
+	{
+		const TOverPlanes<PolicyT> P(Out, Bot, Top);
+		OverPremultipliedPixels(P, 0, P.Num);
+	}
+	void OverPremultiplied(FPlanarMip& Out, const FPlanarMip& Bot, const FPlanarMip& Top);
+	void OverPremultipliedScalar(FPlanarMip& Out, const FPlanarMip& Bot, const FPlanarMip& Top);
+
+	/* Conversions between the two, done once after decoding and before encoding */
+	template<typename PolicyT>
+	void Premultiply(TPlanarMip<PolicyT>& Mip)
+	{
+		const int32 Num = Mip.Num();
+		for (int32 c = 0; c < 3; c++) {
+			typename PolicyT::Scalar* RESTRICT Color = Mip.Plane(c);
+			const typename PolicyT::Scalar* RESTRICT Alpha = Mip.A();
+			for (int32 i = 0; i < Num; i++) {
+				Color[i] = PolicyT::Mul(Color[i], Alpha[i]);
+			}
+		}
+	}
+
+	template<typename PolicyT>
+	void Unpremultiply(TPlanarMip<PolicyT>& Mip)
+	{
+		using Scalar = typename PolicyT::Scalar;
+		using Wide = typename PolicyT::Wide;
+		const int32 Num = Mip.Num();
+		for (int32 i = 0; i < Num; i++) {
+			const Scalar Alpha = Mip.A()[i];
+			const bool bVisible = PolicyT::IsVisible(Alpha);
+			for (int32 c = 0; c < 3; c++) {
+				const Wide Scaled = static_cast<Wide>(Mip.Plane(c)[i]) * PolicyT::ONE;
+				Mip.Plane(c)[i] = bVisible ? PolicyT::Div(Scaled, Alpha) : Scalar(0);
+			}
+			Mip.A()[i] = bVisible ? Alpha : Scalar(0);
+		}
+	}
+
+	/*
+	 * 2x2 box filter into the next mip, SizeX x SizeY of which are real
+	 * pixels, the rest is padding repeating the last row and column.
+	 * Straight alpha colors are weighted by alpha, so that transparent
+	 * pixels do not bleed their color into the visible ones.
+	 */
+	template<typename PolicyT>
+	void Downsample(TPlanarMip<PolicyT>& Out, const TPlanarMip<PolicyT>& In, const int32 SizeX, const int32 SizeY, const bool bPremultiplied)
+	{
+		using Scalar = typename PolicyT::Scalar;
+		fgcheck(2 * SizeX <= In.SizeX and 2 * SizeY <= In.SizeY);
+		Out.Init(Align(SizeX, 4), Align(SizeY, 4));
+		for (int32 y = 0; y < Out.SizeY; y++) {
+			for (int32 x = 0; x < Out.SizeX; x++) {
+				const int32 SrcX = 2 * FMath::Min(x, SizeX - 1);
+				const int32 SrcY = 2 * FMath::Min(y, SizeY - 1);
+				const int32 Src[4] = {
+					SrcY * In.SizeX + SrcX,
+					SrcY * In.SizeX + SrcX + 1,
+					(SrcY + 1) * In.SizeX + SrcX,
+					(SrcY + 1) * In.SizeX + SrcX + 1,
+				};
+				double Sum[4] = { 0, 0, 0, 0 };
+				for (const int32 i : Src) {
+					const double Alpha = PolicyT::ToDouble(In.A()[i]);
+					const double Weight = bPremultiplied ? 1.0 : Alpha;
+					for (int32 c = 0; c < 3; c++) {
+						Sum[c] += Weight * PolicyT::ToDouble(In.Plane(c)[i]);
+					}
+					Sum[3] += Alpha;
+				}
+				const int32 Idx = y * Out.SizeX + x;
+				const double ColorDiv = bPremultiplied ? 4.0 : Sum[3];
+				const bool bVisible = ColorDiv > UE_DOUBLE_SMALL_NUMBER;
+				for (int32 c = 0; c < 3; c++) {
+					Out.Plane(c)[Idx] = bVisible ? PolicyT::FromDouble(Sum[c] / ColorDiv) : Scalar(0);
+				}
+				Out.A()[Idx] = PolicyT::FromDouble(Sum[3] / 4);
+			}
+		}
+	}
+
+	/*
+	 * Layer resampled (bilinear) into a SizeX x SizeY mip, covering W x H
+	 * pixels at (X, Y). Everything outside of that is transparent. Straight
+	 * alpha colors are weighted by alpha, like Downsample does.
+	 */
+	template<typename PolicyT>
+	void Place(TPlanarMip<PolicyT>& Out, const TPlanarMip<PolicyT>& Layer, const int32 X, const int32 Y, const int32 W, const int32 H, const int32 SizeX, const int32 SizeY, const bool bPremultiplied)
+	{
+		using Scalar = typename PolicyT::Scalar;
+		Out.Init(SizeX, SizeY);
+		FMemory::Memzero(Out.Data.GetData(), Out.Data.Num() * sizeof(Scalar));
+		const double StepX = static_cast<double>(Layer.SizeX) / W;
+		const double StepY = static_cast<double>(Layer.SizeY) / H;
+		for (int32 y = FMath::Max(Y, 0); y < FMath::Min(Y + H, SizeY); y++) {
+			const double SrcY = FMath::Clamp((y - Y + 0.5) * StepY - 0.5, 0.0, Layer.SizeY - 1.0);
+			const int32 Y0 = FMath::FloorToInt(SrcY);
+			const int32 Y1 = FMath::Min(Y0 + 1, Layer.SizeY - 1);
+			const double FracY = SrcY - Y0;
+			for (int32 x = FMath::Max(X, 0); x < FMath::Min(X + W, SizeX); x++) {
+				const double SrcX = FMath::Clamp((x - X + 0.5) * StepX - 0.5, 0.0, Layer.SizeX - 1.0);
+				const int32 X0 = FMath::FloorToInt(SrcX);
+				const int32 X1 = FMath::Min(X0 + 1, Layer.SizeX - 1);
+				const double FracX = SrcX - X0;
+				const int32 Src[4] = { Y0 * Layer.SizeX + X0, Y0 * Layer.SizeX + X1, Y1 * Layer.SizeX + X0, Y1 * Layer.SizeX + X1 };
+				const double Weights[4] = { (1 - FracX) * (1 - FracY), FracX * (1 - FracY), (1 - FracX) * FracY, FracX * FracY };
+				double Sum[4] = { 0, 0, 0, 0 };
+				double ColorDiv = bPremultiplied ? 1.0 : 0.0;
+				for (int32 i = 0; i < 4; i++) {
+					const double Alpha = PolicyT::ToDouble(Layer.A()[Src[i]]);
+					const double Weight = bPremultiplied ? Weights[i] : Weights[i] * Alpha;
+					for (int32 c = 0; c < 3; c++) {
+						Sum[c] += Weight * PolicyT::ToDouble(Layer.Plane(c)[Src[i]]);
+					}
+					Sum[3] += Weights[i] * Alpha;
+					ColorDiv += bPremultiplied ? 0.0 : Weight;
+				}
+				const int32 Idx = y * SizeX + x;
+				const bool bVisible = ColorDiv > UE_DOUBLE_SMALL_NUMBER;
+				for (int32 c = 0; c < 3; c++) {
+					Out.Plane(c)[Idx] = bVisible ? PolicyT::FromDouble(Sum[c] / ColorDiv) : Scalar(0);
+				}
+				Out.A()[Idx] = PolicyT::FromDouble(Sum[3]);
+			}
+		}
+	}
+
+	/* Colors times those of Layer, as far as Layer is visible, alpha is kept */
+	template<typename PolicyT>
+	void Multiply(TPlanarMip<PolicyT>& Mip, const TPlanarMip<PolicyT>& Layer, const bool bPremultiplied)
+	{
+		using Scalar = typename PolicyT::Scalar;
+		fgcheck(Mip.HasSameSize(Layer));
+		const int32 Num = Mip.Num();
+		for (int32 i = 0; i < Num; i++) {
+			const Scalar LayerAlpha = Layer.A()[i];
+			for (int32 c = 0; c < 3; c++) {
+				/* lerp(1, Layer, LayerAlpha), which premultiplied is 1 - LayerAlpha + Layer */
+				const Scalar LayerColor = bPremultiplied ? Layer.Plane(c)[i] : PolicyT::Mul(Layer.Plane(c)[i], LayerAlpha);
+				const Scalar Factor = static_cast<Scalar>(PolicyT::ONE - LayerAlpha + LayerColor);
+				Mip.Plane(c)[i] = PolicyT::Mul(Mip.Plane(c)[i], Factor);
+			}
+		}
+	}
+
+	/* Colors towards Color times themselves, by Amount in [0, 1] */
+	template<typename PolicyT>
+	void Tint(TPlanarMip<PolicyT>& Mip, const FLinearColor& Color, const float Amount)
+	{
+		using Scalar = typename PolicyT::Scalar;
+		const float Factors[3] = { Color.R, Color.G, Color.B };
+		const int32 Num = Mip.Num();
+		for (int32 c = 0; c < 3; c++) {
+			const Scalar Factor = PolicyT::FromFloat(FMath::Lerp(1.0f, Factors[c], Amount));
+			Scalar* RESTRICT Plane = Mip.Plane(c);
+			for (int32 i = 0; i < Num; i++) {
+				Plane[i] = PolicyT::Mul(Plane[i], Factor);
+			}
+		}
+	}
+
+	/* Colors towards their Rec. 709 luma, by Amount in [0, 1], works on premultiplied colors too */
+	template<typename PolicyT>
+	void Desaturate(TPlanarMip<PolicyT>& Mip, const float Amount)
+	{
+		const int32 Num = Mip.Num();
+		for (int32 i = 0; i < Num; i++) {
+			const float R = PolicyT::ToFloat(Mip.R()[i]);
+			const float G = PolicyT::ToFloat(Mip.G()[i]);
+			const float B = PolicyT::ToFloat(Mip.B()[i]);
+			const float Luma = 0.2126f * R + 0.7152f * G + 0.0722f * B;
+			Mip.R()[i] = PolicyT::FromFloat(FMath::Lerp(R, Luma, Amount));
+			Mip.G()[i] = PolicyT::FromFloat(FMath::Lerp(G, Luma, Amount));
+			Mip.B()[i] = PolicyT::FromFloat(FMath::Lerp(B, Luma, Amount));
+		}
+	}
+};
@@ -3,6 +3,8 @@
 #pragma once
 
 #include "PreciseColor.h"
+#include "PlanarMip.h"
+#include "DXTEncoder.h"
 
 #include <CoreMinimal.h>
 #include <Math/Color.h>
@@ -15,43 +17,164 @@ static_assert(sizeof(FColor) == sizeof(uint32_t), "FColor size mismatch");
 static_assert(sizeof(FDXT1) == 8, "DXT1 block size mismatch");
 static_assert(sizeof(FDXT5) == 16, "DXT5 block size mismatch");
 
-/* Current Max: DXT5 with 4x4 blocks */
-static const size_t MAX_BLOCK_SIDE = 4;
-static const size_t MAX_BLOCK_PIXELS = MAX_BLOCK_SIDE * MAX_BLOCK_SIDE;
-
 struct FPreciseBlock
 {
 	FPreciseColor Data[MAX_BLOCK_PIXELS];
 };
 
+enum class EMipAccess : uint8
+{
+	ReadOnly,
+	ReadWrite,
+};
+
+/* One mip in its native layout, rows of blocks without padding between them */
+struct FMipMemory
+{
+	uint8* Data = nullptr;
+	int64 NumBytes = 0;
+	int32 SizeX = 0;
+	int32 SizeY = 0;
+	EPixelFormat Format = EPixelFormat::PF_Unknown;
+	EMipAccess Access = EMipAccess::ReadOnly;
+};
+
+/*
+ * Maps a single mip of a texture into 4x4 blocks of precise colors.
+ * Read-only mappers work on a private copy of the mip, writable ones
+ * keep the bulk data locked for their whole lifetime. Either way, create
+ * and destroy mappers on the game thread; in between, they can be used
+ * from any thread as long as writers touch disjoint regions.
+ * The codecs only ever see an FMipMemory, so a mapper can also be made
+ * over plain memory, on any thread and without any texture around.
+ * Coordinates and extents are in pixels and must be block-aligned.
+ * Mips smaller than one block (the tail of a mip chain) can only be
+ * decoded or encoded whole, with planar mips padded up to a full block.
+ */
 class BlockMapper final
 {
 private:
 	struct MapperConcept
 	{
 		virtual ~MapperConcept() = default;
-		virtual FPreciseBlock ReadBlock(size_t x, size_t y) const = 0;
-		virtual void WriteBlock(size_t x, size_t y, const FPreciseBlock& InBlock) = 0;
+		virtual void ReadRegion(size_t x, size_t y, size_t w, size_t h, TArrayView<FPreciseBlock> OutBlocks) const = 0;
+		virtual void WriteRegion(size_t x, size_t y, size_t w, size_t h, TArrayView<const FPreciseBlock> InBlocks) = 0;
+		virtual void DecodeMip(TPlanarMip<FDoublePrecision>& OutMip) const = 0;
+		virtual void DecodeMip(TPlanarMip<FFloatPrecision>& OutMip) const = 0;
+		virtual void DecodeMip(TPlanarMip<FFixed16Precision>& OutMip) const = 0;
+		virtual void EncodeMip(const TPlanarMip<FDoublePrecision>& InMip, TConstArrayView<bool> SkipBlocks) = 0;
+		virtual void EncodeMip(const TPlanarMip<FFloatPrecision>& InMip, TConstArrayView<bool> SkipBlocks) = 0;
+		virtual void EncodeMip(const TPlanarMip<FFixed16Precision>& InMip, TConstArrayView<bool> SkipBlocks) = 0;
+		virtual void SetEncodeOptions(const DXTEncoder::FEncodeOptions& Options) = 0;
+		virtual TConstArrayView<uint8> GetNativeBytes() const = 0;
+		virtual TArrayView<uint8> GetMutableNativeBytes() = 0;
+		virtual EPixelFormat GetPixelFormat() const = 0;
+		virtual size_t GetSizeX() const = 0;
+		virtual size_t GetSizeY() const = 0;
 	protected:
 		friend class BlockMapper;
 		virtual void OnDestruction() = 0;
 	};
 	template<typename NativeBlockType> struct MapperModel;
 
-	static TSharedPtr<MapperConcept> MakeMapper(UTexture2D* Texture, const int32 MipIdx);
+	static TSharedPtr<MapperConcept> MakeMapper(UTexture2D* Texture, const int32 MipIdx, const EMipAccess Access);
+	static TSharedPtr<MapperConcept> MakeMapper(const FMipMemory& Memory, const FString& Name, TArray64<uint8>&& Snapshot, TFunction<void()>&& OnRelease);
 	TSharedPtr<MapperConcept> Mapper;
 public:
-	BlockMapper(UTexture2D* Texture, const int32 MipIdx) : Mapper(MakeMapper(Texture, MipIdx))
+	BlockMapper(UTexture2D* Texture, const int32 MipIdx, const EMipAccess Access) : Mapper(MakeMapper(Texture, MipIdx, Access))
+	{
+	}
+	/* The memory is used in place, it has to outlive the mapper */
+	explicit BlockMapper(const FMipMemory& Memory) : Mapper(MakeMapper(Memory, TEXT("plain memory"), {}, nullptr))
+	{
+	}
+	BlockMapper(const BlockMapper&) = delete;
+	BlockMapper& operator=(const BlockMapper&) = delete;
+
+	EPixelFormat GetPixelFormat() const
 	{
+		return Mapper->GetPixelFormat();
 	}
+	size_t GetSizeX() const
+	{
+		return Mapper->GetSizeX();
+	}
+	size_t GetSizeY() const
+	{
+		return Mapper->GetSizeY();
+	}
+	size_t GetNumBlocksX() const
+	{
+		return FMath::DivideAndRoundUp(GetSizeX(), MAX_BLOCK_SIDE);
+	}
+	size_t GetNumBlocksY() const
+	{
+		return FMath::DivideAndRoundUp(GetSizeY(), MAX_BLOCK_SIDE);
+	}
+
 	FPreciseBlock ReadBlock(size_t x, size_t y) const
 	{
-		return Mapper->ReadBlock(x, y);
+		FPreciseBlock Block;
+		Mapper->ReadRegion(x, y, MAX_BLOCK_SIDE, MAX_BLOCK_SIDE, MakeArrayView(&Block, 1));
+		return Block;
 	}
 	void WriteBlock(size_t x, size_t y, const FPreciseBlock& InBlock)
 	{
-		Mapper->WriteBlock(x, y, InBlock);
+		Mapper->WriteRegion(x, y, MAX_BLOCK_SIDE, MAX_BLOCK_SIDE, MakeArrayView(&InBlock, 1));
 	}
+
+	/* Blocks are stored in row-major order, (w / 4) * (h / 4) of them */
+	void ReadRegion(size_t x, size_t y, size_t w, size_t h, TArrayView<FPreciseBlock> OutBlocks) const
+	{
+		Mapper->ReadRegion(x, y, w, h, OutBlocks);
+	}
+	void WriteRegion(size_t x, size_t y, size_t w, size_t h, TArrayView<const FPreciseBlock> InBlocks)
+	{
+		Mapper->WriteRegion(x, y, w, h, InBlocks);
+	}
+
+	/* A row is one block tall and spans the whole mip */
+	void ReadRow(size_t y, TArrayView<FPreciseBlock> OutBlocks) const
+	{
+		ReadRegion(0, y, GetSizeX(), MAX_BLOCK_SIDE, OutBlocks);
+	}
+	void WriteRow(size_t y, TArrayView<const FPreciseBlock> InBlocks)
+	{
+		WriteRegion(0, y, GetSizeX(), MAX_BLOCK_SIDE, InBlocks);
+	}
+
+	/* Only used when writing block compressed formats */
+	void SetEncodeOptions(const DXTEncoder::FEncodeOptions& Options)
+	{
+		Mapper->SetEncodeOptions(Options);
+	}
+
+	/* The mip exactly as the texture stores it */
+	TConstArrayView<uint8> GetNativeBytes() const
+	{
+		return Mapper->GetNativeBytes();
+	}
+	TArrayView<uint8> GetMutableNativeBytes()
+	{
+		return Mapper->GetMutableNativeBytes();
+	}
+
+	/*
+	 * Whole mip at once, into or from separate R, G, B and A planes.
+	 * When encoding block compressed formats, blocks set in SkipBlocks
+	 * (one per 4x4 block, row-major) are left as they are.
+	 */
+	template<typename PolicyT>
+	void DecodeMip(TPlanarMip<PolicyT>& OutMip) const
+	{
+		Mapper->DecodeMip(OutMip);
+	}
+	template<typename PolicyT>
+	void EncodeMip(const TPlanarMip<PolicyT>& InMip, TConstArrayView<bool> SkipBlocks = {})
+	{
+		Mapper->EncodeMip(InMip, SkipBlocks);
+	}
+
 	~BlockMapper()
 	{
 		Mapper->OnDestruction();
@@ -0,0 +1,93 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#pragma once
+
+#include <CoreMinimal.h>
+
+/*
+ * Precision policies for planar mips and the kernels working on them.
+ * Every policy maps [0, 1] onto its Scalar type and provides the few
+ * operations the kernels need:
+ *
+ *  - Mul(A, B):        product of two normalized values
+ *  - Div(Num, Den):    Num / Den, where Num is a Wide product of two values
+ *  - IsVisible(Alpha): whether a pixel has enough coverage to have a color
+ *  - ToUnorm8:         same quantization as FLinearColor::ToFColor
+ *
+ * FDoublePrecision is the reference the others are checked against.
+ */
+
+namespace ColorPrecision
+{
+	/* FLinearColor::ToFColor on a single channel */
+	FORCEINLINE uint8 QuantizeUnorm8(float Value, const bool bSRGB)
+	{
+		Value = FMath::Clamp(Value, 0.0f, 1.0f);
+		if (bSRGB) {
+			Value = Value <= 0.0031308f ? Value * 12.92f : FMath::Pow(Value, 1.0f / 2.4f) * 1.055f - 0.055f;
+		}
+		return static_cast<uint8>(FMath::FloorToInt(Value * 255.999f));
+	}
+
+	/* Quantization tables indexed by a 16-bit fixed point value */
+	const uint8* GetLinearLut16();
+	const uint8* GetSRGBLut16();
+};
+
+struct FDoublePrecision
+{
+	using Scalar = double;
+	using Wide = double;
+	static constexpr Scalar ONE = 1.0;
+
+	static FORCEINLINE Scalar FromFloat(const float Value) { return Value; }
+	static FORCEINLINE Scalar FromDouble(const double Value) { return Value; }
+	static FORCEINLINE Scalar FromUnorm8(const uint8 Value) { return Value / 255.0; }
+	static FORCEINLINE float ToFloat(const Scalar Value) { return static_cast<float>(Value); }
+	static FORCEINLINE double ToDouble(const Scalar Value) { return Value; }
+	static FORCEINLINE uint8 ToUnorm8(const Scalar Value, const bool bSRGB) { return ColorPrecision::QuantizeUnorm8(static_cast<float>(Value), bSRGB); }
+
+	static FORCEINLINE Scalar Mul(const Scalar A, const Scalar B) { return A * B; }
+	static FORCEINLINE Scalar Div(const Wide Num, const Scalar Den) { return Num / Den; }
+	static FORCEINLINE bool IsVisible(const Scalar Alpha) { return Alpha > UE_DOUBLE_SMALL_NUMBER; }
+};
+
+struct FFloatPrecision
+{
+	using Scalar = float;
+	using Wide = float;
+	static constexpr Scalar ONE = 1.0f;
+
+	static FORCEINLINE Scalar FromFloat(const float Value) { return Value; }
+	static FORCEINLINE Scalar FromDouble(const double Value) { return static_cast<float>(Value); }
+	static FORCEINLINE Scalar FromUnorm8(const uint8 Value) { return Value / 255.0f; }
+	static FORCEINLINE float ToFloat(const Scalar Value) { return Value; }
+	static FORCEINLINE double ToDouble(const Scalar Value) { return Value; }
+	static FORCEINLINE uint8 ToUnorm8(const Scalar Value, const bool bSRGB) { return ColorPrecision::QuantizeUnorm8(Value, bSRGB); }
+
+	static FORCEINLINE Scalar Mul(const Scalar A, const Scalar B) { return A * B; }
+	static FORCEINLINE Scalar Div(const Wide Num, const Scalar Den) { return Num / Den; }
+	static FORCEINLINE bool IsVisible(const Scalar Alpha) { return Alpha > UE_SMALL_NUMBER; }
+};
+
+/* Unsigned 16-bit fixed point, 0xffff is 1.0, products are rounded */
+struct FFixed16Precision
+{
+	using Scalar = uint16;
+	using Wide = uint32;
+	static constexpr Scalar ONE = 0xffff;
+
+	static FORCEINLINE Scalar FromFloat(const float Value) { return static_cast<Scalar>(FMath::RoundToInt(FMath::Clamp(Value, 0.0f, 1.0f) * ONE)); }
+	static FORCEINLINE Scalar FromDouble(const double Value) { return static_cast<Scalar>(FMath::RoundToInt(FMath::Clamp(Value, 0.0, 1.0) * ONE)); }
+	static FORCEINLINE Scalar FromUnorm8(const uint8 Value) { return Value * 257; }
+	static FORCEINLINE float ToFloat(const Scalar Value) { return Value / static_cast<float>(ONE); }
+	static FORCEINLINE double ToDouble(const Scalar Value) { return Value / static_cast<double>(ONE); }
+	static FORCEINLINE uint8 ToUnorm8(const Scalar Value, const bool bSRGB)
+	{
+		return (bSRGB ? ColorPrecision::GetSRGBLut16() : ColorPrecision::GetLinearLut16())[Value];
+	}
+
+	static FORCEINLINE Scalar Mul(const Scalar A, const Scalar B) { return static_cast<Scalar>((static_cast<Wide>(A) * B + ONE / 2) / ONE); }
+	static FORCEINLINE Scalar Div(const Wide Num, const Scalar Den) { return static_cast<Scalar>(FMath::Min<Wide>((Num + Den / 2) / Den, ONE)); }
+	static FORCEINLINE bool IsVisible(const Scalar Alpha) { return Alpha > 0; }
+};
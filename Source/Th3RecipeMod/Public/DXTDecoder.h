@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#pragma once
+
+#include "Th3Simd.h"
+#include "PlanarBlock.h"
+
+#include <CoreMinimal.h>
+#include <Math/Color.h>
+
+/*
+ * DXT1/DXT5 decoders that build the color and alpha palettes once
+ * per block and then only expand the indices. They produce the same
+ * colors as the FPreciseColor reference, rounded to float.
+ */
+namespace DXTDecoder
+{
+	struct FColorPalette
+	{
+		alignas(16) float R[4];
+		alignas(16) float G[4];
+		alignas(16) float B[4];
+		alignas(16) float A[4];
+	};
+
+	struct FAlphaPalette
+	{
+		alignas(32) float A[8];
+	};
+
+	void BuildColorPalette(FColorPalette& OutPalette, const FDXT1& InBlock, const bool bAllowThreeColors);
+	void BuildAlphaPalette(FAlphaPalette& OutPalette, const uint8 Alpha0, const uint8 Alpha1);
+	uint64 GetAlphaIndices(const FDXT5& InBlock);
+
+	/* Plain table lookups, always available */
+	void DecodeDXT1Scalar(FPlanarBlock& OutBlock, const FDXT1& InBlock);
+	void DecodeDXT5Scalar(FPlanarBlock& OutBlock, const FDXT5& InBlock);
+
+	/* Widest instruction set the module was built for */
+	void DecodeDXT1(FPlanarBlock& OutBlock, const FDXT1& InBlock);
+	void DecodeDXT5(FPlanarBlock& OutBlock, const FDXT5& InBlock);
+};
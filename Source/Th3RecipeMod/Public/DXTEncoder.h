@@ -0,0 +1,29 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#pragma once
+
+#include "DXTDecoder.h"
+
+#include <CoreMinimal.h>
+#include <Math/Color.h>
+
+/*
+ * Range-fit DXT1/DXT5 encoders. Endpoints are the extremes of the block
+ * colors projected onto their principal axis, indices are picked against
+ * the palette as the GPU expands it (with low bit replication).
+ * Refinement re-solves the endpoints by least squares for the chosen
+ * indices, and is only kept when it lowers the block error.
+ */
+namespace DXTEncoder
+{
+	struct FEncodeOptions
+	{
+		bool bRefine = true;
+	};
+
+	/* Pixels with less alpha than this become transparent in DXT1 */
+	static constexpr float DXT1_ALPHA_THRESHOLD = 0.5f;
+
+	void EncodeDXT1(FDXT1& OutBlock, const FPlanarBlock& InBlock, const FEncodeOptions& Options);
+	void EncodeDXT5(FDXT5& OutBlock, const FPlanarBlock& InBlock, const FEncodeOptions& Options);
+};
@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#pragma once
+
+#include "PlanarMip.h"
+
+#include <CoreMinimal.h>
+
+/* Current Max: DXT5 with 4x4 blocks */
+static const size_t MAX_BLOCK_SIDE = 4;
+static const size_t MAX_BLOCK_PIXELS = MAX_BLOCK_SIDE * MAX_BLOCK_SIDE;
+
+/* A decoded 4x4 block with one plane per channel, pixels in row-major order */
+struct alignas(32) FPlanarBlock
+{
+	float R[16];
+	float G[16];
+	float B[16];
+	float A[16];
+};
+
+/* Scatters a decoded 4x4 block into the four pixel rows it covers */
+template<typename PolicyT>
+static FORCEINLINE void StorePlanarBlock(TPlanarMip<PolicyT>& OutMip, const FPlanarBlock& Block, const size_t x, const size_t y)
+{
+	for (size_t h = 0; h < MAX_BLOCK_SIDE; h++) {
+		const size_t Idx = (y + h) * OutMip.SizeX + x;
+		for (size_t w = 0; w < MAX_BLOCK_SIDE; w++) {
+			const size_t Src = h * MAX_BLOCK_SIDE + w;
+			OutMip.R()[Idx + w] = PolicyT::FromFloat(Block.R[Src]);
+			OutMip.G()[Idx + w] = PolicyT::FromFloat(Block.G[Src]);
+			OutMip.B()[Idx + w] = PolicyT::FromFloat(Block.B[Src]);
+			OutMip.A()[Idx + w] = PolicyT::FromFloat(Block.A[Src]);
+		}
+	}
+}
+
+/* Gathers the 4x4 block at (x, y) of a planar mip */
+template<typename PolicyT>
+static FORCEINLINE void LoadPlanarBlock(FPlanarBlock& OutBlock, const TPlanarMip<PolicyT>& InMip, const size_t x, const size_t y)
+{
+	for (size_t h = 0; h < MAX_BLOCK_SIDE; h++) {
+		const size_t Idx = (y + h) * InMip.SizeX + x;
+		for (size_t w = 0; w < MAX_BLOCK_SIDE; w++) {
+			const size_t Dst = h * MAX_BLOCK_SIDE + w;
+			OutBlock.R[Dst] = PolicyT::ToFloat(InMip.R()[Idx + w]);
+			OutBlock.G[Dst] = PolicyT::ToFloat(InMip.G()[Idx + w]);
+			OutBlock.B[Dst] = PolicyT::ToFloat(InMip.B()[Idx + w]);
+			OutBlock.A[Dst] = PolicyT::ToFloat(InMip.A()[Idx + w]);
+		}
+	}
+}
@@ -0,0 +1,77 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#pragma once
+
+#include "ColorPrecision.h"
+
+#include <CoreMinimal.h>
+
+/*
+ * A whole mip decoded into separate R, G, B and A planes, so that
+ * kernels can run as plain loops over contiguous memory. The extent is
+ * padded up to whole 4x4 blocks, pixels are stored in row-major order.
+ */
+template<typename PolicyT>
+struct TPlanarMip
+{
+	using Policy = PolicyT;
+	using Scalar = typename PolicyT::Scalar;
+
+	int32 SizeX = 0;
+	int32 SizeY = 0;
+	TArray<Scalar> Data;
+
+	TPlanarMip() = default;
+	TPlanarMip(int32 InSizeX, int32 InSizeY)
+	{
+		Init(InSizeX, InSizeY);
+	}
+
+	FORCEINLINE void Init(int32 InSizeX, int32 InSizeY)
+	{
+		SizeX = InSizeX;
+		SizeY = InSizeY;
+		Data.SetNumUninitialized(4 * Num());
+	}
+
+	FORCEINLINE int32 Num() const
+	{
+		return SizeX * SizeY;
+	}
+
+	FORCEINLINE bool HasSameSize(const TPlanarMip& Other) const
+	{
+		return SizeX == Other.SizeX and SizeY == Other.SizeY;
+	}
+
+	FORCEINLINE Scalar* Plane(int32 Channel)
+	{
+		return Data.GetData() + Channel * Num();
+	}
+	FORCEINLINE const Scalar* Plane(int32 Channel) const
+	{
+		return Data.GetData() + Channel * Num();
+	}
+
+	FORCEINLINE Scalar* R() { return Plane(0); }
+	FORCEINLINE Scalar* G() { return Plane(1); }
+	FORCEINLINE Scalar* B() { return Plane(2); }
+	FORCEINLINE Scalar* A() { return Plane(3); }
+	FORCEINLINE const Scalar* R() const { return Plane(0); }
+	FORCEINLINE const Scalar* G() const { return Plane(1); }
+	FORCEINLINE const Scalar* B() const { return Plane(2); }
+	FORCEINLINE const Scalar* A() const { return Plane(3); }
+
+	/* Converts every channel of every pixel into another precision */
+	template<typename OtherPolicyT>
+	void ConvertTo(TPlanarMip<OtherPolicyT>& Out) const
+	{
+		Out.Init(SizeX, SizeY);
+		const int32 NumValues = Data.Num();
+		for (int32 i = 0; i < NumValues; i++) {
+			Out.Data[i] = OtherPolicyT::FromDouble(Policy::ToDouble(Data[i]));
+		}
+	}
+};
+
+using FPlanarMip = TPlanarMip<FFloatPrecision>;
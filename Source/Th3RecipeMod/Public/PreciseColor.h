@@ -148,6 +148,7 @@ struct FPreciseColor
 		if (FMath::IsNearlyZero(Alpha)) {
 			return FPreciseColor();
 		}
-		return (Top * TopCoef + Bot * BotCoef) / Alpha;
+		/* Only the color channels get weighted, the result alpha is the coverage itself */
+		return ((Top * TopCoef + Bot * BotCoef) / Alpha).WithAlpha(Alpha);
 	}
 };
\ No newline at end of file
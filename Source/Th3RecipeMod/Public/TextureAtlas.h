@@ -0,0 +1,81 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#pragma once
+
+#include <CoreMinimal.h>
+#include <Engine/Texture2D.h>
+#include <Styling/SlateBrush.h>
+#include <UObject/GCObject.h>
+#include <UObject/ObjectKey.h>
+
+DECLARE_LOG_CATEGORY_EXTERN(LogTh3TextureAtlas, Log, All);
+
+/* Where a texture ended up, UV is in 0..1 over the whole page */
+struct FAtlasSlot
+{
+	TWeakObjectPtr<UTexture2D> Page;
+	FBox2f UV = FBox2f(ForceInit);
+	int32 Size = 0;
+
+	bool IsValid() const
+	{
+		return Page.IsValid();
+	}
+
+	FSlateBrush MakeBrush() const;
+};
+
+/*
+ * Square textures of the same size and format, copied block by block into
+ * a grid on a few large pages, mips included. Each slot is padded with
+ * copies of its edge blocks, and pages only get the mips that padding
+ * still covers, so filtering never reaches into a neighbouring slot.
+ * Each page is one texture and one RHI resource, however many textures
+ * it holds. Changed pages are only
+ * uploaded by Flush(), and a full page drops its CPU copy once uploaded.
+ * Every upload is the whole page, so callers adding a few textures at a
+ * time should pass a minimum interval for pages that are still filling.
+ * Game thread only.
+ */
+class FTextureAtlas : public FGCObject
+{
+public:
+	explicit FTextureAtlas(const int32 InPageSize = 2048) : PageSize(InPageSize) {}
+
+	/* Needs the CPU copy of every mip of Texture, returns the existing slot if it was added before */
+	FAtlasSlot Add(const UTexture2D* Texture);
+	/* Invalid if Texture was never added, or did not fit in any page */
+	FAtlasSlot Find(const UTexture2D* Texture) const;
+	/* Pages that are not full yet are skipped if they were uploaded less than MinIntervalSeconds ago */
+	void Flush(const double MinIntervalSeconds = 0.0);
+
+	int32 GetNumPages() const
+	{
+		return Pages.Num();
+	}
+
+	virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+	virtual FString GetReferencerName() const override
+	{
+		return TEXT("FTextureAtlas");
+	}
+private:
+	struct FPage
+	{
+		TObjectPtr<UTexture2D> Texture;
+		EPixelFormat Format;
+		int32 SlotSize;
+		int32 NumUsed = 0;
+		bool bDirty = false;
+		double LastFlush = 0.0;
+	};
+	FPage* FindPage(const EPixelFormat Format, const int32 SlotSize);
+	FPage& AddPage(const EPixelFormat Format, const int32 SlotSize);
+	int32 GetGutter(const EPixelFormat Format, const int32 SlotSize) const;
+	int32 GetNumMips(const EPixelFormat Format, const int32 SlotSize) const;
+	int32 GetSlotsPerRow(const EPixelFormat Format, const int32 SlotSize) const;
+
+	const int32 PageSize;
+	TArray<FPage> Pages;
+	TMap<TObjectKey<UTexture2D>, FAtlasSlot> Slots;
+};
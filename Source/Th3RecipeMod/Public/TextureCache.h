@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#pragma once
+
+#include <CoreMinimal.h>
+#include <PixelFormat.h>
+
+DECLARE_LOG_CATEGORY_EXTERN(LogTh3TextureCache, Log, All);
+
+/*
+ * Generated mip chains kept on disk between launches, one file per key.
+ * A file is a small header followed by the native bytes of every mip,
+ * so loading is a memory map plus one copy per mip, without decoding.
+ */
+namespace TextureCache
+{
+	/* Hash of everything the generated texture depends on */
+	struct FKey
+	{
+		uint64 Hash = 0;
+
+		FString ToString() const
+		{
+			return FString::Printf(TEXT("%016llx"), Hash);
+		}
+	};
+
+	FString GetCacheDir();
+
+	/* Fills every mip in OutMips, false if the entry is missing or does not have the same layout. Any thread, like Store */
+	bool Load(const FKey& Key, const EPixelFormat Format, TArrayView<const TArrayView<uint8>> OutMips);
+
+	/* Safe to call from any thread, as long as no two calls share a key */
+	bool Store(const FKey& Key, const EPixelFormat Format, TArrayView<const TConstArrayView<uint8>> InMips);
+};
@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#pragma once
+
+#include <CoreMinimal.h>
+#include <Engine/Texture2D.h>
+#include <UObject/ObjectKey.h>
+
+DECLARE_LOG_CATEGORY_EXTERN(LogTh3TextureResidency, Log, All);
+
+/*
+ * Keeps source textures streamed in while their mips are read. Add every
+ * texture a batch needs first, so that they all stream at the same time,
+ * then either Wait() once or poll IsReady(). Textures are forced to stay
+ * resident even if their mips are resident already, the streamer could
+ * evict them before they are read otherwise, and are let go again by
+ * Release() or when this goes away. Game thread only.
+ */
+class FTextureResidency
+{
+public:
+	FTextureResidency() = default;
+	FTextureResidency(const FTextureResidency&) = delete;
+	FTextureResidency& operator=(const FTextureResidency&) = delete;
+	~FTextureResidency()
+	{
+		Release();
+	}
+
+	/* Mips from FirstMipIdx down to the smallest one are needed */
+	void Add(UTexture2D* Texture, const int32 FirstMipIdx);
+
+	bool IsReady() const;
+	void Wait();
+	void Release();
+
+	bool IsEmpty() const
+	{
+		return Textures.IsEmpty();
+	}
+
+	/* Whether some residency keeps the texture resident, BlockMapper only streams it in by itself otherwise */
+	static bool IsPinned(const UTexture2D* Texture);
+private:
+	struct FEntry
+	{
+		/* Still finds the pin after the texture is gone */
+		TObjectKey<UTexture2D> Key;
+		TWeakObjectPtr<UTexture2D> Texture;
+		int32 FirstMipIdx;
+	};
+	TArray<FEntry> Textures;
+};
@@ -19,11 +19,23 @@
 #include <Unlocks/FGUnlockSchematic.h>
 #include <Engine/AssetManager.h>
 #include <Engine/StreamableManager.h>
+#include <Containers/Ticker.h>
 
 #include "Th3RootInstance.generated.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(LogTh3RootInstance, Log, All);
 
+UENUM()
+enum class ETh3IconFormat : uint8
+{
+	/* 1-bit alpha, 4 bits per pixel */
+	BC1 UMETA(DisplayName = "BC1 (DXT1)"),
+	/* Interpolated alpha, 8 bits per pixel */
+	BC3 UMETA(DisplayName = "BC3 (DXT5)"),
+	/* 32 bits per pixel */
+	Uncompressed UMETA(DisplayName = "Uncompressed (B8G8R8A8)"),
+};
+
 UCLASS(Abstract)
 class TH3RECIPEMOD_API UTh3RootInstance : public UGameInstanceModule
 {
@@ -35,6 +47,9 @@ private:
 
 	const int32 CAT_PRIORITY_DELTA = 100;
 
+	/* Atlas pages still filling up are uploaded at most this often while lazy icons come in */
+	const double LAZY_ATLAS_FLUSH_SECONDS = 1.0;
+
 	int32 CompressionMenuPriority = 1;
 
 	/* Marked as UPROPERTY because it holds CDO edits */
@@ -51,6 +66,23 @@ private:
 	TMap<TSubclassOf<UFGItemDescriptor>, TSubclassOf<UFGItemDescriptor>> ItemToCompressedMap;
 	TMap<TSubclassOf<UFGCategory>, TSubclassOf<UFGCategory>> CategoryToCompressedMap;
 
+	/* Loaded from CompressedIconOverlay, stays null on dedicated servers */
+	UPROPERTY(Transient)
+	UTexture2D* IconOverlay = nullptr;
+
+	/* Icons of compressed items, composited together once all schematics are done */
+	Th3Tex2DUtils::FOverlayBatch IconBatch;
+
+	/* In lazy mode, icons are only composited once the game first asks for them */
+	TMap<TSubclassOf<UFGItemDescriptor>, UTexture2D*> LazyIconBases;
+	Th3Tex2DUtils::FOverlayQueue LazyIconQueue;
+	FTSTicker::FDelegateHandle LazyIconTicker;
+	FDelegateHandle SmallIconHook;
+	FDelegateHandle BigIconHook;
+
+	/* Pages every generated icon is also copied into, when enabled */
+	FTextureAtlas IconAtlas;
+
 	const FTextFormat CompressedDisplayNameFmt = NSLOCTEXT("FTh3RecipeMod", "CompressedItemFmt", "{CompressedPrefix} {DisplayName}");
 	FORCEINLINE FText CompressDisplayName(const FText& DisplayName)
 	{
@@ -64,6 +96,17 @@ protected:
 	void MakeConversionRecipe(const FItemAmount& Ingredients, const FItemAmount& Products);
 	void MakeCompressionRecipes(const TSubclassOf<UFGItemDescriptor>& OrigItem, const TSubclassOf<UFGItemDescriptor>& NewItem);
 	UTexture2D* GetItemIcon(UFGItemDescriptor* OrigCDO);
+	Th3Tex2DUtils::FOverlayOptions GetIconOverlayOptions();
+	void SetCompressedIcon(UFGItemDescriptor* NewCDO, UTexture2D* Icon);
+	void LoadIconOverlay();
+	void RequestLazyIcon(const TSubclassOf<UFGItemDescriptor>& Item);
+	void EnableLazyIcons();
+	bool TickLazyIcons(float DeltaTime);
+public:
+	/* Brush for the icon of a compressed item, on an atlas page if it is on one */
+	UFUNCTION(BlueprintPure, Category = "Th3RecipeMod")
+	FSlateBrush GetCompressedIconBrush(TSubclassOf<UFGItemDescriptor> Item) const;
+protected:
 	TSubclassOf<UFGItemDescriptor> CompressedFormOf(const TSubclassOf<UFGItemDescriptor>& OrigItem);
 	bool InvokeRecipePredicate(const TSubclassOf<UFGRecipe>& Recipe, const TFunction<bool(const UFGRecipe*)> InPredicate);
 	bool IsCraftingRecipeCompressible(const TSubclassOf<UFGRecipe>& Recipe);
@@ -101,8 +144,43 @@ public:
 	UPROPERTY(EditDefaultsOnly, Category = "Mod Configuration")
 	const TSubclassOf<UFGItemCategory> DecompressionCategory;
 
+	/* Never loaded on dedicated servers, compressed items keep the original icons there */
+	UPROPERTY(EditDefaultsOnly, Category = "Mod Configuration")
+	TSoftObjectPtr<UTexture2D> CompressedIconOverlay;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Mod Configuration")
+	ETh3IconFormat CompressedIconFormat = ETh3IconFormat::BC3;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Mod Configuration")
+	bool bRefineCompressedIcons = true;
+
+	/* Keep generated icons on disk, so that later launches only load them */
+	UPROPERTY(EditDefaultsOnly, Category = "Mod Configuration")
+	bool bCacheCompressedIcons = true;
+
+	/* Build icon mips down to 1x1 from the first one, instead of compositing each mip */
+	UPROPERTY(EditDefaultsOnly, Category = "Mod Configuration")
+	bool bDownsampleCompressedIconMips = true;
+
+	/* Drop the CPU copy of generated icons once they are on the GPU, they can no longer be read as sources or atlased then */
 	UPROPERTY(EditDefaultsOnly, Category = "Mod Configuration")
-	UTexture2D* CompressedIconOverlay;
+	bool bDiscardCompressedIconCpuData = false;
+
+	/* Largest generated icon width in pixels, 0 for the size of the base icon */
+	UPROPERTY(EditDefaultsOnly, Category = "Mod Configuration", Meta = (ClampMin = 0))
+	int32 MaxCompressedIconSize = 0;
+
+	/* Also pack generated icons into a few large textures, for UI that draws through GetCompressedIconBrush. Every icon is still uploaded on its own too, the game's UI draws those */
+	UPROPERTY(EditDefaultsOnly, Category = "Mod Configuration")
+	bool bAtlasCompressedIcons = false;
+
+	/* Composite icons on first use instead of at startup, ignored in the editor */
+	UPROPERTY(EditDefaultsOnly, Category = "Mod Configuration")
+	bool bLazyCompressedIcons = false;
+
+	/* Game thread time lazy icons may take per frame */
+	UPROPERTY(EditDefaultsOnly, Category = "Mod Configuration", Meta = (ClampMin = 0.1, EditCondition = "bLazyCompressedIcons"))
+	float LazyIconBudgetMs = 2.0f;
 
 	UPROPERTY(EditDefaultsOnly, Category = "Mod Configuration")
 	FText CompressedPrefixText;
@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: MPL-2.0 */
+
+#pragma once
+
+#include <CoreMinimal.h>
+
+#if PLATFORM_CPU_X86_FAMILY && PLATFORM_ENABLE_VECTORINTRINSICS
+#define TH3_SIMD_SSE2 1
+#else
+#define TH3_SIMD_SSE2 0
+#endif
+
+/* Only when the whole module is built for AVX2, there is no runtime dispatch */
+#if TH3_SIMD_SSE2 && (defined(__AVX2__) || (defined(PLATFORM_ALWAYS_HAS_AVX_2) && PLATFORM_ALWAYS_HAS_AVX_2))
+#define TH3_SIMD_AVX2 1
+#else
+#define TH3_SIMD_AVX2 0
+#endif
+
+#if TH3_SIMD_AVX2
+#include <immintrin.h>
+#elif TH3_SIMD_SSE2
+#include <emmintrin.h>
+#endif
@@ -2,14 +2,161 @@
 
 #pragma once
 
+#include "TextureResidency.h"
+#include "TextureAtlas.h"
+
 #include <CoreMinimal.h>
 #include <Engine/TextureDefines.h>
 #include <Engine/Texture2D.h>
 #include <Rendering/Texture2DResource.h>
+#include <UObject/GCObject.h>
 
 DECLARE_LOG_CATEGORY_EXTERN(LogTh3Tex2DUtils, Log, All);
 
 namespace Th3Tex2DUtils
 {
-	UTexture2D* OverlayTextures(UTexture2D* Bot, UTexture2D* Top);
-};
+	struct FOverlayOptions
+	{
+		/* One of PF_DXT1, PF_DXT5 or PF_B8G8R8A8 */
+		EPixelFormat OutputFormat = EPixelFormat::PF_DXT5;
+		/* Slower, but lower error when encoding DXT blocks */
+		bool bRefineEndpoints = true;
+		/* Reuse textures generated by earlier launches, see TextureCache.h */
+		bool bUseCache = true;
+		/* Composite the first mip only, then box filter it down to 1x1 instead of compositing every mip */
+		bool bDownsampleMips = false;
+		/* Let go of the CPU copy of the mips once they are uploaded, the texture can no longer be read back then */
+		bool bDiscardCpuData = false;
+		/* Largest width of the generated texture, larger source mips are skipped, 0 for no limit */
+		int32 MaxSize = 0;
+		/* Also copy the generated texture into a page of this atlas, which the caller uploads with Flush() */
+		FTextureAtlas* Atlas = nullptr;
+	};
+
+	enum class ECompositionOp : uint8
+	{
+		/* Layer over the texture so far */
+		Over,
+		/* Texture so far times Layer, wherever Layer is visible */
+		Multiply,
+		/* Texture so far times Color, blended in by Amount */
+		Tint,
+		/* Texture so far towards grey, by Amount */
+		Desaturate,
+	};
+
+	struct FCompositionStep
+	{
+		ECompositionOp Op = ECompositionOp::Over;
+		UTexture2D* Layer = nullptr;
+		/* Where Layer goes, as fractions of the texture width: top left corner and size */
+		FVector2f Offset = FVector2f::ZeroVector;
+		float Scale = 1.0f;
+		FLinearColor Color = FLinearColor::White;
+		float Amount = 1.0f;
+	};
+
+	/* Steps run in order, e.g. FComposition().Tint(Color).Over(Badge, { 0.5f, 0.5f }, 0.5f) */
+	struct FComposition
+	{
+		TArray<FCompositionStep> Steps;
+
+		FComposition& Over(UTexture2D* Layer, const FVector2f Offset = FVector2f::ZeroVector, const float Scale = 1.0f)
+		{
+			Steps.Add({ .Op = ECompositionOp::Over, .Layer = Layer, .Offset = Offset, .Scale = Scale });
+			return *this;
+		}
+		FComposition& Multiply(UTexture2D* Layer, const FVector2f Offset = FVector2f::ZeroVector, const float Scale = 1.0f)
+		{
+			Steps.Add({ .Op = ECompositionOp::Multiply, .Layer = Layer, .Offset = Offset, .Scale = Scale });
+			return *this;
+		}
+		FComposition& Tint(const FLinearColor& Color, const float Amount = 1.0f)
+		{
+			Steps.Add({ .Op = ECompositionOp::Tint, .Color = Color, .Amount = Amount });
+			return *this;
+		}
+		FComposition& Desaturate(const float Amount = 1.0f)
+		{
+			Steps.Add({ .Op = ECompositionOp::Desaturate, .Amount = Amount });
+			return *this;
+		}
+	};
+
+	/*
+	 * Runs every step on each mip of Base, decoding it once and encoding
+	 * the result once, without intermediate textures. Layers may be any
+	 * size, each mip uses the closest layer mip that is at least as big.
+	 */
+	UTexture2D* ComposeTexture(UTexture2D* Base, const FComposition& Composition, const FOverlayOptions& Options = FOverlayOptions());
+
+	/* Decodes every mip of an overlay up front, otherwise that happens the first time it is used */
+	void PrepareOverlay(UTexture2D* Top);
+	/* Drops the decoded mips of an overlay that is not going to be used again, jobs still using them keep theirs */
+	void ReleaseOverlay(const UTexture2D* Top);
+
+	UTexture2D* OverlayTextures(UTexture2D* Bot, UTexture2D* Top, const FOverlayOptions& Options = FOverlayOptions());
+
+	/* Gets the new texture, or Bot if it could not be generated */
+	using FOnOverlayDone = TFunction<void(UTexture2D* Result)>;
+
+	struct FOverlayRequest
+	{
+		UTexture2D* Bot;
+		UTexture2D* Top;
+		FOverlayOptions Options;
+		FOnOverlayDone OnDone;
+	};
+
+	/*
+	 * Queues overlays to composite them all at once. Run() sets up every
+	 * texture on the game thread, composites all of their mips in parallel
+	 * and then hands out the results, again on the game thread.
+	 */
+	class FOverlayBatch
+	{
+	public:
+		void Add(UTexture2D* Bot, UTexture2D* Top, const FOverlayOptions& Options, FOnOverlayDone OnDone);
+		int32 Num() const
+		{
+			return Requests.Num();
+		}
+		void Run();
+	private:
+		TArray<FOverlayRequest> Requests;
+	};
+
+	/*
+	 * Composites queued overlays one by one in the background. Tick() does
+	 * the game thread parts (setup, upload and callbacks) in request order,
+	 * but only until the given time budget for the frame is used up.
+	 * Holds on to the sources and outputs of every request it still has,
+	 * outputs are written by worker tasks across frames.
+	 */
+	class FOverlayQueue : public FGCObject
+	{
+	public:
+		FOverlayQueue();
+		~FOverlayQueue();
+
+		void Add(UTexture2D* Bot, UTexture2D* Top, const FOverlayOptions& Options, FOnOverlayDone OnDone);
+		bool IsIdle() const
+		{
+			return Pending.IsEmpty() and InFlight.IsEmpty();
+		}
+		void Tick(const double BudgetSeconds);
+
+		virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+		virtual FString GetReferencerName() const override
+		{
+			return TEXT("Th3Tex2DUtils::FOverlayQueue");
+		}
+	private:
+		struct FInFlight;
+		TArray<FOverlayRequest> Pending;
+		TArray<TUniquePtr<FInFlight>> InFlight;
+		/* The first NumStaged pending requests, whose sources are streaming in */
+		FTextureResidency Residency;
+		int32 NumStaged = 0;
+	};
+};
\ No newline at end of file